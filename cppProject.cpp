@@ -1,53 +1,525 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <cstring>
+#include <cstdio>
 #include <iomanip>
 #include <limits>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <charconv>
+#include <sstream>
+#include <fstream>
+#include <atomic>
+#include <streambuf>
+#include <cmath>
+#include <climits>
 #include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GB_X86_SIMD 1
+#endif
 
 using std::cout;
 using std::cin;
 
 //constants 
-const int MAX_STUDENT = 50;
-const int MAX_TESTS = 8;
+const int MAX_TESTS = 100; //sanity bound for the prompt; storage is sized by testCount
 const int ID_LEN = 11;
-const int NAME_LEN = 32;
+const int NAME_LEN = 32;  //longest name readName accepts (names are pooled, not padded)
+
+//Marks are whole numbers 0..100, so each one is stored in a byte. MARK_UNGRADED
+//marks a test that has no result yet (an empty CSV field). It is left out of
+//totals, averages, min/max and statistics until a real mark is set (an
+//average is over the graded tests only), and prints as "-".
+typedef std::uint8_t Mark;
+const Mark MARK_UNGRADED = 0xff;
+
+// ---------------- operation statistics ----------------
+// Menu dispatches and the hot kernels are timed with steady_clock. Each thread
+// counts into its own StatBlock: calls, total time and a histogram with one
+// bucket per power of two nanoseconds. A block is only ever written by its
+// thread (relaxed loads and stores, no locked read-modify-write), so a timed
+// call costs two clock reads; the stats view adds up every thread's block.
+
+enum StatOp
+{
+    STAT_MENU_ADD, STAT_MENU_UPDATE, STAT_MENU_REPORT, STAT_MENU_SUMMARY, STAT_MENU_LIST,
+    STAT_MENU_SNAPSHOT, STAT_MENU_TOP, STAT_MENU_ASSESSMENTS, STAT_MENU_STATS, STAT_MENU_BULK,
+    STAT_MENU_EXPORT, STAT_MENU_ID_LIST, STAT_MENU_FILTER, STAT_MENU_NAME, //same order as the menu
+    STAT_FIND_ID, STAT_NAME_SEARCH, STAT_ID_SORT, STAT_RANK_SORT, STAT_RANKING_TABLE, STAT_TOP_K, STAT_COLUMN_STATS,
+    STAT_AGGREGATES, STAT_BULK_UPDATE, STAT_EXPORT, STAT_QUERY_SCAN, STAT_READ_INPUT, STAT_SERVER_REQUEST,
+    STAT_COURSE_REPORTS, STAT_COURSE_MERGE, STAT_OPS
+};
+
+const char* const STAT_NAMES[STAT_OPS] = {
+    "menu: add student", "menu: update mark", "menu: student report", "menu: class summary",
+    "menu: list students", "menu: save snapshot", "menu: top/bottom", "menu: assessment stats",
+    "menu: operation stats", "menu: bulk update", "menu: export reports", "menu: list by id",
+    "menu: filter", "menu: find by name", "findStudentById", "name search", "id radix sort",
+    "ranking sort", "ranking table", "top-k selection", "assessment columns", "aggregate rebuild",
+    "bulk mark update", "report export", "filter scan", "input parse", "server request", "course reports", "cross-course merge"};
+
+const int STAT_BUCKETS = 40; //bucket b holds [2^(b-1), 2^b) ns; the last one is open ended
+
+struct StatBlock
+{
+    std::atomic<std::uint64_t> calls[STAT_OPS];
+    std::atomic<std::uint64_t> totalNs[STAT_OPS];
+    std::atomic<std::uint64_t> hist[STAT_OPS][STAT_BUCKETS];
+};
+
+struct StatRegistry
+{
+    std::mutex lock;
+    std::vector<std::unique_ptr<StatBlock>> blocks; //one per thread that ever timed something
+};
+
+StatRegistry& statRegistry()
+{
+    static StatRegistry registry;
+    return registry;
+}
+
+bool statsEnabled = true; //--no-stats
+
+StatBlock& threadStats()
+{
+    thread_local StatBlock* mine = nullptr;
+    if (!mine)
+    {
+        std::unique_ptr<StatBlock> block(new StatBlock()); //value-initialized: all zero
+        mine = block.get();
+        StatRegistry &reg = statRegistry();
+        std::lock_guard<std::mutex> held(reg.lock);
+        reg.blocks.push_back(std::move(block));
+    }
+    return *mine;
+}
+
+// Only the owning thread writes a counter, so a plain load + store is enough.
+void statAdd(std::atomic<std::uint64_t> &counter, std::uint64_t v)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+void statRecord(int op, std::uint64_t ns)
+{
+    StatBlock &b = threadStats();
+    int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+    statAdd(b.calls[op], 1);
+    statAdd(b.totalNs[op], ns);
+    statAdd(b.hist[op][bucket < STAT_BUCKETS ? bucket : STAT_BUCKETS - 1], 1);
+}
+
+// Times its own lifetime as one call of op.
+struct OpTimer
+{
+    int op;
+    bool on;
+    std::chrono::steady_clock::time_point start;
+
+    explicit OpTimer(int op) : op(op), on(statsEnabled)
+    {
+        if (on) start = std::chrono::steady_clock::now();
+    }
+    ~OpTimer()
+    {
+        if (on) statRecord(op, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+};
+
+// Upper bound of the bucket holding the p-th percentile call, in ns.
+double histPercentile(const std::uint64_t* hist, std::uint64_t calls, int p)
+{
+    std::uint64_t rank = (calls * p + 99) / 100, seen = 0;
+    for (int b=0; b<STAT_BUCKETS; b++)
+    {
+        seen += hist[b];
+        if (seen >= rank && seen > 0) return std::ldexp(1.0, b);
+    }
+    return std::ldexp(1.0, STAT_BUCKETS - 1);
+}
+
+// Sums every thread's counters and prints one line per operation that ran.
+void writeOpStats(std::ostream &out)
+{
+    std::vector<std::uint64_t> calls(STAT_OPS), totalNs(STAT_OPS), hist(std::size_t(STAT_OPS) * STAT_BUCKETS);
+    {
+        StatRegistry &reg = statRegistry();
+        std::lock_guard<std::mutex> held(reg.lock);
+        for (const std::unique_ptr<StatBlock> &b : reg.blocks)
+        {
+            for (int op=0; op<STAT_OPS; op++)
+            {
+                calls[op] += b->calls[op].load(std::memory_order_relaxed);
+                totalNs[op] += b->totalNs[op].load(std::memory_order_relaxed);
+                for (int k=0; k<STAT_BUCKETS; k++) hist[op * STAT_BUCKETS + k] += b->hist[op][k].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    out<<"\n-------- Operation Statistics --------\n\n";
+    out<<std::left<<std::setw(24)<<"Operation"
+       <<std::right<<std::setw(10)<<"Calls"
+       <<std::setw(12)<<"Total ms"
+       <<std::setw(11)<<"Mean us"
+       <<std::setw(11)<<"p50 us <="
+       <<std::setw(11)<<"p99 us <="
+       <<"\n";
+    out<<std::string(79,'-')<<"\n";
+    out<<std::fixed<<std::setprecision(2);
+    for (int op=0; op<STAT_OPS; op++)
+    {
+        if (calls[op] == 0) continue;
+        const std::uint64_t* h = hist.data() + std::size_t(op) * STAT_BUCKETS;
+        out<<std::left<<std::setw(24)<<STAT_NAMES[op]
+           <<std::right<<std::setw(10)<<calls[op]
+           <<std::setw(12)<<totalNs[op] / 1e6
+           <<std::setw(11)<<totalNs[op] / 1e3 / calls[op]
+           <<std::setw(11)<<histPercentile(h, calls[op], 50) / 1e3
+           <<std::setw(11)<<histPercentile(h, calls[op], 99) / 1e3
+           <<"\n";
+    }
+    out<<'\n';
+}
+
+// --stats-file: the same table, written when the program ends.
+void writeStatsFile(const char* path)
+{
+    if (!path) return;
+    std::ofstream file(path);
+    writeOpStats(file);
+    if (!file) cout<<"Could not write "<<path<<"\n";
+}
+
+// Writes the --stats-file when main returns, whichever way it returns.
+struct StatsFileAtExit
+{
+    const char* path;
+    ~StatsFileAtExit() { writeStatsFile(path); }
+};
+
+// ---------------- batch input ----------------
+// When stdin is not a terminal (a script piped or redirected in) the readers
+// below skip cin and take tokens straight out of a large block read from fd 0.
+// A token is a pointer into that block, so nothing is copied before it is
+// parsed. No prompts or menu are printed.
+//
+// A script is one command per line: the menu choice, then the answers to its
+// prompts in order. A text answer followed by more answers (a name before the
+// marks, a filter before the view) runs up to the answers that close the line:
+//   2 ets0000001 3 78
+//   1 ets0000002 Ann Lee 90 85 77
+//   13 avg >= 50 and t2 < 40 1
+// A command only reads from its own line. A bad or missing value, or a command
+// that fails (an unknown id, say), is reported as "line N: ..." and the rest
+// of the line is dropped: nothing is retried, and no value of one command is
+// ever read as the next command.
+
+const std::size_t BATCH_BLOCK = 1 << 20;
+
+struct BatchInput
+{
+    std::vector<char> buf;
+    std::size_t pos = 0, end = 0; //unread bytes are buf[pos, end)
+    long long line = 1;           //line of the next unread byte
+    long long tokenLine = 1;      //line the last token started on
+    bool eof = false;
+    bool inCommand = false;       //a menu command is reading its arguments (from its own line)
+    bool lineOpen = false;        //something has been read from the current line
+    bool failed = false;          //the command hit an error; it reads nothing more
+    bool ended = false;           //the script ran out; nothing more is read or changed
+};
+
+BatchInput* batchInput = nullptr; //set by main when stdin is not a terminal
+
+// Moves the unread bytes to the front and reads another block after them.
+// Returns false once stdin has nothing more to give.
+bool batchFill(BatchInput &in)
+{
+    if (in.eof) return false;
+    if (in.pos > 0)
+    {
+        std::memmove(in.buf.data(), in.buf.data() + in.pos, in.end - in.pos);
+        in.end -= in.pos;
+        in.pos = 0;
+    }
+    if (in.buf.size() - in.end < BATCH_BLOCK) in.buf.resize(in.end + BATCH_BLOCK);
+    ssize_t n;
+    do n = read(STDIN_FILENO, in.buf.data() + in.end, in.buf.size() - in.end);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
+    {
+        in.eof = true;
+        return false;
+    }
+    in.end += std::size_t(n);
+    return true;
+}
+
+// Skips whitespace, counting newlines. Inside a command it stops at the end of
+// the line. False when there is nothing more to read there.
+bool batchSkipSpace(BatchInput &in)
+{
+    while (true)
+    {
+        while (in.pos < in.end && isspace(static_cast<unsigned char>(in.buf[in.pos])))
+        {
+            if (in.buf[in.pos] == '\n')
+            {
+                if (in.inCommand) return false;
+                in.line++;
+                in.lineOpen = false;
+            }
+            in.pos++;
+        }
+        if (in.pos < in.end) return true;
+        if (!batchFill(in)) return false;
+    }
+}
+
+// A value was asked for and the line (or the script) has none left. Between
+// commands that is the normal end of the script; inside one the command fails.
+void batchMissing(BatchInput &in)
+{
+    if (in.inCommand && !in.failed)
+    {
+        cout<<"line "<<in.line<<": missing value\n";
+        in.failed = true;
+    }
+    if (in.eof && in.pos >= in.end) in.ended = true;
+}
+
+// The next whitespace-separated token; valid until the next batch read.
+bool batchToken(BatchInput &in, std::string_view &tok)
+{
+    if (in.failed) return false;
+    if (!batchSkipSpace(in))
+    {
+        batchMissing(in);
+        return false;
+    }
+    in.tokenLine = in.line;
+    in.lineOpen = true;
+    std::size_t len = 0;
+    while (true)
+    {
+        while (in.pos + len < in.end && !isspace(static_cast<unsigned char>(in.buf[in.pos + len]))) len++;
+        if (in.pos + len < in.end || !batchFill(in)) break; //batchFill moves the token to the front
+    }
+    tok = std::string_view(in.buf.data() + in.pos, len);
+    in.pos += len;
+    return true;
+}
+
+// Text that may hold spaces: the rest of the line, less the last keepTokens
+// tokens, which are the answers still to come (a name before its marks).
+// Trailing spaces and a '\r' (scripts written on Windows) are dropped.
+bool batchLine(BatchInput &in, std::string_view &text, int keepTokens)
+{
+    if (in.failed) return false;
+    if (!batchSkipSpace(in))
+    {
+        batchMissing(in);
+        return false;
+    }
+    in.tokenLine = in.line;
+    in.lineOpen = true;
+    std::size_t len = 0;
+    while (true)
+    {
+        while (in.pos + len < in.end && in.buf[in.pos + len] != '\n') len++;
+        if (in.pos + len < in.end || !batchFill(in)) break;
+    }
+    const char* s = in.buf.data() + in.pos;
+    auto space = [&](std::size_t i) { return isspace(static_cast<unsigned char>(s[i - 1])) != 0; };
+    while (len > 0 && space(len)) len--;
+    for (int k=0; k<keepTokens; k++)
+    {
+        while (len > 0 && !space(len)) len--;
+        while (len > 0 && space(len)) len--;
+    }
+    if (len == 0)
+    {
+        batchMissing(in);
+        return false;
+    }
+    text = std::string_view(s, len);
+    in.pos += len;
+    return true;
+}
+
+// Drops the rest of the current line, as clearBadInput does for typed input.
+void batchSkipLine(BatchInput &in)
+{
+    in.lineOpen = false;
+    while (true)
+    {
+        const char* nl = static_cast<const char*>(std::memchr(in.buf.data() + in.pos, '\n', in.end - in.pos));
+        if (nl)
+        {
+            in.pos = std::size_t(nl - in.buf.data()) + 1;
+            in.line++;
+            return;
+        }
+        in.pos = in.end;
+        if (!batchFill(in)) return;
+    }
+}
+
+// Called before each menu choice: the last command is over, so whatever it
+// left on its line is dropped and the choice is read from the next line.
+void batchNextCommand(BatchInput &in)
+{
+    in.inCommand = false;
+    if (in.lineOpen) batchSkipLine(in);
+    in.failed = false;
+}
+
+// Reports a bad value of the running command; the command reads nothing more.
+void batchReject(BatchInput &in)
+{
+    in.failed = true;
+    cout<<"line "<<in.tokenLine<<": ";
+}
+
+// A number as the interactive reader takes it: anything cin>>double accepts,
+// truncated toward zero.
+bool parseBatchInt(std::string_view tok, int &out)
+{
+    double x = 0;
+    auto res = std::from_chars(tok.data(), tok.data() + tok.size(), x);
+    if (res.ec != std::errc() || res.ptr != tok.data() + tok.size()) return false;
+    if (!(x > INT_MIN && x < INT_MAX)) return false;
+    out = static_cast<int>(x);
+    return true;
+}
+
+// True once a script has run out.
+bool inputEnded()
+{
+    return batchInput && batchInput->ended;
+}
+
+// True when a script ran out or the running command's line had an error; the
+// menu functions check it after reading and stop before changing anything.
+bool inputAborted()
+{
+    return batchInput && (batchInput->ended || batchInput->failed);
+}
+
+// Starts the message for a command that could not be carried out. In a
+// script it is prefixed with the command's line, and the command is over.
+std::ostream& commandError()
+{
+    if (batchInput) batchReject(*batchInput);
+    return cout;
+}
 
 void clearBadInput(){
     cin.clear();
     cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
 
+// The input readers time only the parse (STAT_READ_INPUT): the timer starts
+// once a token or line is in hand, so waiting on the user or the pipe is not counted.
 int readInt(std::string prompt){
+    if (batchInput)
+    {
+        std::string_view tok;
+        int n = 0;
+        if (!batchToken(*batchInput, tok)) return 0;
+        {
+            OpTimer timer(STAT_READ_INPUT);
+            if (parseBatchInt(tok, n)) return n;
+        }
+        batchReject(*batchInput);
+        cout<<"invalid number \""<<tok<<"\"\n";
+        return 0;
+    }
     double x{};
     while(true)
     {
         cout<<prompt; //dynamic prompt
-        if (cin >> x ) return x;
-        else{
-            clearBadInput();
-            cout<< "Invalid number. Try again!\n";
-        }  
+        cin>>std::ws; //blocks until the user has typed something
+        {
+            OpTimer timer(STAT_READ_INPUT);
+            if (cin >> x ) return x;
+        }
+        clearBadInput();
+        cout<< "Invalid number. Try again!\n";
     }
 }
 
 int readIntRange(std::string prompt, int minV, int maxV){
     while (true){
         int x = readInt(prompt);
+        if (inputAborted()) return minV;
         if (minV<= x && x <=maxV){
             return x;
+        }else if (batchInput){
+            batchReject(*batchInput);
+            cout<<"number must be between ["<< minV <<", "<<maxV <<"]\n";
+            return minV;
         }else{
             cout <<"Number must be between ["<< minV <<", "<<maxV <<"]\n";
         }
     }
 }
 
-void readName(std::string prompt, char* out, int maxsize){
+// Copies a batch line into out if it fits, reporting it otherwise.
+bool batchText(std::string_view text, char* out, int maxsize)
+{
+    if (text.size() >= std::size_t(maxsize))
+    {
+        batchReject(*batchInput);
+        cout<<"input too long (max "<<(maxsize - 1)<<" characters)\n";
+        return false;
+    }
+    std::memcpy(out, text.data(), text.size());
+    out[text.size()] = '\0';
+    return true;
+}
+
+// keepTokens: in a script, how many answers follow the text on its line.
+void readName(std::string prompt, char* out, int maxsize, int keepTokens){
+    if (batchInput)
+    {
+        std::string_view text;
+        out[0] = '\0';
+        if (!batchLine(*batchInput, text, keepTokens)) return;
+        OpTimer timer(STAT_READ_INPUT);
+        if (!batchText(text, out, maxsize)) out[0] = '\0';
+        return;
+    }
     while(true)
     {
         cout<<prompt;
         cin>>std::ws;
+        OpTimer timer(STAT_READ_INPUT);
         cin.getline(out, maxsize);
         if (cin.fail())
         {
@@ -61,11 +533,43 @@ void readName(std::string prompt, char* out, int maxsize){
     }
 }
 
+// Checks the ets/ETS prefix and lowercases the id in place (case insensative).
+// Shared by readId and the CSV import so both accept exactly the same ids.
+bool normalizeId(char* id)
+{
+    bool sLetter = std::strncmp(id, "ets", 3) ==0;
+    bool cLetter = std::strncmp(id, "ETS", 3) ==0; 
+
+    if (std::strlen(id) <= 3 || (!(sLetter || cLetter))) return false;
+    for (int i = 0; id[i] != '\0'; ++i) 
+    {
+        char a = std::tolower(static_cast<unsigned char>(id[i]));
+        id[i] = static_cast<char>(a);
+    }
+    return true;
+}
+
 void readId(std::string prompt, char* out, int maxsize){
+    if (batchInput)
+    {
+        std::string_view tok;
+        out[0] = '\0';
+        if (!batchToken(*batchInput, tok)) return;
+        OpTimer timer(STAT_READ_INPUT);
+        if (batchText(tok, out, maxsize) && normalizeId(out)) return;
+        if (!batchInput->failed)
+        {
+            batchReject(*batchInput);
+            cout<<"ID must start with ets/ETS and include more characters after it\n";
+        }
+        out[0] = '\0';
+        return;
+    }
     while(true)
     {
         cout<<prompt;
         cin>>std::ws;
+        OpTimer timer(STAT_READ_INPUT);
         cin.getline(out, maxsize);
         if (cin.fail())
         {
@@ -73,337 +577,6046 @@ void readId(std::string prompt, char* out, int maxsize){
             cout << "Input too long (max " << (maxsize - 1) << " characters). Try again.\n";
             continue;
         }
-        bool sLetter = std::strncmp(out, "ets", 3) ==0;
-        bool cLetter = std::strncmp(out, "ETS", 3) ==0; 
-
-        if (std::strlen(out) <= 3 || (!(sLetter || cLetter)))
+        if (!normalizeId(out))
         {
             cout << "ID must start with ets/ETS and include more characters after it.\n";
             continue;
         }
-        if (std::strlen(out) >3)
-        {
-            //case insensative
-            for (int i = 0; out[i] != '\0'; ++i) 
-            {
-                char a = std::tolower(static_cast<unsigned char>(out[i]));
-                out[i] = static_cast<char>(a);
-            }
-            return;
-        }
-        
-        clearBadInput();
-        cout<<"Invalid Input. Try again. \n";
+        return;
     }
 }
 
-int findStudentById(
-    const char ids[][ID_LEN],
-    const char* id,
-    int studentCount
-)
+// A column is either owned (a vector) or borrowed from a memory-mapped
+// snapshot. Reads go straight to whichever is live; own() copies a borrowed
+// column into memory the first time it has to change.
+template <typename T>
+struct Column
 {
-    for(int i=0; i< studentCount; i++)
+    std::vector<T> owned;
+    const T* mapped = nullptr;
+    std::size_t mappedCount = 0;
+
+    const T* data() const { return mapped ? mapped : owned.data(); }
+    std::size_t size() const { return mapped ? mappedCount : owned.size(); }
+    bool empty() const { return size() == 0; }
+    const T& operator[](std::size_t i) const { return data()[i]; }
+
+    std::vector<T>& own()
+    {
+        if (mapped)
         {
-            if (std::strcmp(ids[i], id)==0) return i;
+            owned.assign(mapped, mapped + mappedCount);
+            mapped = nullptr;
+            mappedCount = 0;
         }
-    return -1; //stud not found!
-}
+        return owned;
+    }
 
-double sumRow(const double* row, int tests)
-{
-    double total = 0;
-    for (int i=0; i<tests; i++)
+    void borrow(const T* p, std::size_t count)
     {
-        total +=row[i];
+        owned.clear();
+        owned.shrink_to_fit();
+        mapped = p;
+        mappedCount = count;
     }
-    return total;
-}
+};
 
-int maxScore(const double* row, int tests)
+// Keeps a snapshot file mapped for as long as any column borrows from it.
+struct MappedFile
 {
-    double mx = row[0];
-    for (int i=1; i<tests; i++)
+    void* addr = nullptr;
+    std::size_t size = 0;
+    ~MappedFile() { if (addr) munmap(addr, size); }
+};
+
+std::uint64_t checksum64(const void* data, std::size_t len, std::uint64_t seed)
+{
+    const std::uint64_t k = 0x9E3779B97F4A7C15ULL;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    //four independent lanes so the multiplies overlap
+    std::uint64_t lane[4] = {seed, seed ^ k, seed + k, seed - k};
+    while (len >= 32)
+    {
+        for (int i=0; i<4; i++)
+        {
+            std::uint64_t w;
+            std::memcpy(&w, p + 8 * i, 8);
+            lane[i] = (lane[i] ^ w) * k;
+            lane[i] ^= lane[i] >> 29;
+        }
+        p += 32;
+        len -= 32;
+    }
+    std::uint64_t h = lane[0] ^ (lane[1] << 16 | lane[1] >> 48) ^ (lane[2] << 32 | lane[2] >> 32) ^ (lane[3] << 48 | lane[3] >> 16);
+    while (len > 0)
     {
-        if (row[i] > mx) mx=row[i];
+        std::uint64_t w = 0;
+        std::size_t n = len < 8 ? len : 8;
+        std::memcpy(&w, p, n);
+        h = (h ^ w ^ n) * k;
+        h ^= h >> 29;
+        p += n;
+        len -= n;
     }
-    return mx;
+    h ^= h >> 33;
+    h *= k;
+    h ^= h >> 29;
+    return h;
 }
 
-int minScore(const double* row, int tests)
+bool writeAll(int fd, const void* data, std::size_t len)
 {
-    double mn = row[0];
-    for (int i=1; i<tests; i++)
+    const char* p = static_cast<const char*>(data);
+    while (len > 0)
     {
-        if (row[i]<mn) mn = row[i];
+        ssize_t w = write(fd, p, len);
+        if (w < 0) return false;
+        p += w;
+        len -= static_cast<std::size_t>(w);
     }
-    return mn;
+    return true;
 }
 
-double average(const double* row, int tests)
-{
-    return tests > 0 ? (double( sumRow(row, tests) ) / double(tests)) : 0.0;
-}
+// ---------------- write-ahead journal (--journal file) ----------------
+// Every addStudent / updateMarks is appended as a compact binary record:
+//   [u32 length][u8 type][payload][u32 checksum]   (length = 1 + payload)
+//   ADD: u8 idLen, id, u8 nameLen, name, testCount x u8 mark
+//   SET: u8 idLen, id, u8 test (0-based), u8 mark
+//   BEGIN, COMMIT: no payload; they bracket a group, see beginGroup
+// Records reference students by id, so replaying a journal that was already
+// folded into the snapshot is harmless (ADDs are duplicates, SETs rewrite the
+// same values).
+// Commits are grouped: records collect in a buffer that a background thread
+// writes out (and fsyncs, depending on the policy) every intervalMs or once
+// groupBytes have piled up, so a burst of updates shares one fsync.
 
-std::string letterGrade(double avg)
-{
-    if (avg > 90) return "A+";
-    else if (avg >= 85) return "A";
-    else if (avg >= 80) return "A-";
-    else if (avg >= 75) return "B+";
-    else if (avg >= 70) return "B";
-    else if (avg >= 65) return "B-";
-    else if (avg >= 60) return "C+";
-    else if (avg >= 50) return "C-";
-    else return "F";
-}
+const char JOURNAL_MAGIC[8] = {'G','B','J','R','N','L','\0','\0'};
+const std::uint32_t JOURNAL_VERSION = 1;
+const unsigned char JOURNAL_ADD = 1;
+const unsigned char JOURNAL_SET = 2;
+const unsigned char JOURNAL_BEGIN = 3;
+const unsigned char JOURNAL_COMMIT = 4;
 
-void printStudentReport(
-    const char ids[][ID_LEN],
-    const char names[][NAME_LEN],
-    const double marks[][MAX_TESTS],
-    int studentCount,
-    int testCount)
+struct JournalHeader
 {
-    char id[ID_LEN];
-    readId("Enter Student ID: ", id, ID_LEN);
-    int idx = findStudentById(ids, id, studentCount);
-    if (idx == -1)
-    {
-        cout << "Student not found!\n";
-        return;
-    }
-    const double* row = marks[idx]; //add marks..
-    double total = sumRow(row, testCount); //address
-    double avg = average(row, testCount);
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t idLen;
+    std::uint32_t testCount;
+    std::uint32_t checksum; //of the fields above
+};
 
-    cout<< "\n--- Student Report ---\n\n";
-    cout<<"ID:           "<<id <<"\n";
-    cout<<"Name:         "<<names[idx] <<"\n";
-    cout<<"Marks:        "; for (int i=0; i < testCount; i++) {cout<<marks[idx][i] <<(i+1==testCount ? "" : ", "); }cout<<'\n';
-    cout<<"Total:        "<<std::fixed<<std::setprecision(2)<<total <<"\n";
-    cout<<"Minimum Mark: "<<minScore(row, testCount) <<"\n";
-    cout<<"Highest Mark: "<<maxScore(row, testCount) <<"\n";
-    cout<<"Average:      "<<std::fixed<<std::setprecision(2)<<avg <<"\n";
-    cout<<"Grade:        "<<std::left<<std::setw(5)<<letterGrade(avg) <<"\n";
-    cout<<"Status:       "; cout<<(avg>=50 ? "Pass": "Fail")<<"\n\n";
-}
+enum class FsyncPolicy { Always, Batch, Never };
 
-void listStudents(
-    const char ids[][ID_LEN],
-    const char names[][NAME_LEN],
-    const double marks[][MAX_TESTS],
-    int studentCount,
-    int testCount
-)
+struct Journal
 {
-    if (studentCount==0) 
+    int fd = -1;
+    FsyncPolicy policy = FsyncPolicy::Batch;
+    int intervalMs = 20;
+    std::size_t groupBytes = 1 << 16;
+    std::vector<char> pending;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::thread flusher;
+    int groupDepth = 0;     //>0 while a multi-record operation is being logged
+    std::size_t groupStart = 0; //where the open group's BEGIN sits in pending
+    bool writing = false;   //a batch is on its way to the file; the next one waits for it
+    bool stopping = false;
+    bool failed = false;
+    std::uint64_t records = 0;
+    std::uint64_t syncs = 0;
+
+    ~Journal() { close(); }
+
+    // Writes out whatever is pending; the caller holds `lock` through `held`.
+    // One batch is in flight at a time, so batches reach the file in the
+    // order their records were appended.
+    void writePending(std::unique_lock<std::mutex> &held)
     {
-        cout<<"No students yet.\n";
-        return;
+        while (writing) drained.wait(held);
+        if (pending.empty()) return;
+        std::vector<char> batch;
+        batch.swap(pending);
+        writing = true;
+        held.unlock();
+        bool ok = writeAll(fd, batch.data(), batch.size());
+        if (ok && policy != FsyncPolicy::Never) ok = fdatasync(fd) == 0;
+        held.lock();
+        writing = false;
+        if (!ok) failed = true;
+        ++syncs;
+        drained.notify_all();
     }
-    
-    cout<<"\n-------------------- Student List -------------------\n\n";
-    cout<< std::left<<std::setw(15)<<"ID"
-        <<std::setw(20)<<"Name"
-        <<std::right<<std::setw(10)<<"Average"
-        <<std::setw(8)<<"Grade"
-        <<'\n';
-    cout<<std::string(15+10+20+8,'-')<<'\n';
 
-    for (int i=0; i<studentCount; i++)
+    // Returns, still holding `lock`, once nothing is pending or being written.
+    void drain(std::unique_lock<std::mutex> &held)
     {
-        double avg = average(marks[i], testCount);
-        cout<< std::left<<std::setw(15)<<ids[i]
-        <<std::setw(20)<<names[i]
-        <<std::right<<std::setw(10)<<std::fixed<<std::setprecision(2)<<avg
-        <<std::setw(8)<<letterGrade(avg)
-        <<'\n';
+        while (writing || !pending.empty()) writePending(held);
     }
-    cout<<'\n';
-}
 
-void addStudent(
-    char ids[][ID_LEN],
-    char names[][NAME_LEN],
-    double marks[][MAX_TESTS],
-    int &studentCount,
-    int testCount
-)
-{
-    if (studentCount >= MAX_STUDENT){
-        cout<<"Class is full (maximum student reached.)";
-        return;
+    void run()
+    {
+        std::unique_lock<std::mutex> held(lock);
+        while (!stopping)
+        {
+            wake.wait_for(held, std::chrono::milliseconds(intervalMs));
+            if (groupDepth == 0) writePending(held); //an open group goes out whole, from endGroup
+        }
+        writePending(held);
     }
-    char id[ID_LEN]{};
-    char name[NAME_LEN]{};
 
-    readId("Enter a New Student ID: ", id, ID_LEN );
-    if (findStudentById(ids, id, studentCount) > -1) 
+    void append(const char* record, std::size_t len)
     {
-        cout<<"Student id alread exists!";
-        return ;
-    } 
-    //copy into fixed arrays
-    readName("Enter a Student Name: ", name, NAME_LEN);
-    std::strncpy(ids[studentCount],  id, ID_LEN-1);
-    std::strncpy(names[studentCount], name, NAME_LEN-1);
-    
-    cout << "Enter the scores for " << testCount << " assessment(s) (0 to 100).\n";
-    for (int i=0; i<testCount; i++){
-        marks[studentCount][i] = readIntRange("mark: ", 0, 100); //readIntRange(std::string prompt, int minV, int maxV)
+        std::unique_lock<std::mutex> held(lock);
+        pending.insert(pending.end(), record, record + len);
+        ++records;
+        if (policy == FsyncPolicy::Always && groupDepth == 0) writePending(held);
+        else if (pending.size() >= groupBytes) wake.notify_one();
+        //back-pressure: don't let a burst outrun the disk by more than a few groups
+        if (pending.size() >= 16 * groupBytes && groupDepth == 0)
+        {
+            if (!flusher.joinable()) writePending(held);
+            while (pending.size() >= 16 * groupBytes && !failed) drained.wait(held);
+        }
     }
-    ++studentCount;
-    cout<<"Student added.\n";
-}
 
-void updateMarks(
-    char ids[][ID_LEN],
-    char names[][NAME_LEN],
-    double marks[][MAX_TESTS],
-    int &studentCount,
-    int testCount
-)
-{
-    char id[ID_LEN];
-    readId("Enter Student ID: ", id, ID_LEN);
-    int idx = findStudentById(ids, id, studentCount);
-    if (idx<0){
-        cout<<"Student not found!\n";
-        return;
+    // Forces everything appended so far to disk (used at commit points).
+    void flush()
+    {
+        std::unique_lock<std::mutex> held(lock);
+        drain(held);
     }
-    cout << "Updating assessment score(s) for " << names[idx] << " (" << ids[idx] << ").\n";
 
-    cout << "Select the assessment to update:\n";
-    for (int i=0; i<testCount; i++)
+    // Queues a record without payload; the caller holds `lock`.
+    void appendMarker(unsigned char type)
     {
-        cout << " " << (i + 1) << ") Current score: " << marks[idx][i] << "\n";
+        char rec[4 + 1 + 4];
+        std::uint32_t length = 1;
+        std::memcpy(rec, &length, 4);
+        rec[4] = static_cast<char>(type);
+        std::uint32_t sum = static_cast<std::uint32_t>(checksum64(rec + 4, length, 0));
+        std::memcpy(rec + 5, &sum, 4);
+        pending.insert(pending.end(), rec, rec + sizeof(rec));
     }
-    int testNo = readIntRange("", 1, testCount);
-    int newValue = readIntRange("New Value: ", 0, 100);
-
-    marks[idx][testNo-1] = newValue;
-    cout<<"Updated.\n";
-}
 
-void classSummaryAndRanging(
-    char ids[][ID_LEN],
-    char names[][NAME_LEN],
-    double marks[][MAX_TESTS],
-    int &studentCount,
-    int testCount
-)
-{
-    if (studentCount==0){
-        cout<<"No Students yet.\n";
-        return;
+    // Records appended between beginGroup and endGroup are committed together,
+    // even under the "always" policy: nothing of the group is written before
+    // endGroup, and replayJournal drops a group whose COMMIT is missing, so
+    // after a crash all of it replays or none of it does.
+    void beginGroup()
+    {
+        std::lock_guard<std::mutex> held(lock);
+        if (groupDepth++ > 0) return;
+        groupStart = pending.size();
+        appendMarker(JOURNAL_BEGIN);
     }
 
-    int order[MAX_STUDENT];
-    for(int i=0; i<studentCount; ++i) order[i] = i;
+    void endGroup()
+    {
+        std::unique_lock<std::mutex> held(lock);
+        if (--groupDepth > 0) return;
+        if (pending.size() == groupStart + 9) pending.resize(groupStart); //an empty group leaves no trace
+        else appendMarker(JOURNAL_COMMIT);
+        writePending(held);
+    }
 
-    // Selection sort by average descending
-    for(int i=0; i<studentCount-1; i++)
+    void start()
     {
-        int best = i; //guess
-        //compare it with the rest of students
-        for (int j= i+1; j< studentCount; ++j)
-        {
-            double aBest = average(marks[order[best]], testCount);
-            double jBest = average(marks[order[j]], testCount);
-            //update status
-            if (aBest < jBest) best=j;
+        if (policy != FsyncPolicy::Always) flusher = std::thread([this] { run(); });
+    }
 
-            //swap position of order indexes e.g order[0,1,2,3,4] swap 0 and 3 i=0 j =3 best = j temp=order[i]=3,order[i] = order[best]=3, order[best] = temp
-        }
-        if (best !=i)
+    void close()
+    {
+        if (fd < 0) return;
         {
-            int temp = order[i]; //current i
-            order[i] = order[best];
-            order[best] = temp;
+            std::lock_guard<std::mutex> held(lock);
+            stopping = true;
         }
+        wake.notify_one();
+        if (flusher.joinable()) flusher.join();
+        std::unique_lock<std::mutex> held(lock);
+        drain(held);
+        if (policy == FsyncPolicy::Never) fsync(fd);
+        ::close(fd);
+        fd = -1;
     }
+};
 
-    // class status
-    double classSum = 0.0;
-    double bestAvg = -1;
-    double worstAvg = 101;
-    int passCount = 0;
-    for (int i=0 ; i<studentCount; i++)
-    {
-        double avg = average(marks[i], testCount);
-        classSum +=avg;
-        if (avg > bestAvg) bestAvg = avg;
-        if (avg < worstAvg) worstAvg = avg;
-        if (avg >= 50) ++passCount;
-    }
+std::uint32_t journalHeaderChecksum(const JournalHeader &h)
+{
+    return static_cast<std::uint32_t>(checksum64(&h, offsetof(JournalHeader, checksum), 0));
+}
 
-    cout<<"\n------ Class Summary -------\n\n";
-    cout<<"Number of Students : "<<studentCount<<"\n";
-    cout<<"Class Average      : "<<std::fixed<<std::setprecision(2) << (classSum / studentCount)<<'\n';
-    cout<<"Highest Average    : "<<bestAvg<<'\n';
-    cout<<"Lowest Average     : "<<worstAvg<<'\n';
-    cout<<"Pass Rate          : "<<std::fixed<<std::setprecision(2) <<(double(passCount) / studentCount) * 100.0<<"% \n";
-
-    cout << "\n-------- Performance Ranking (Highest to Lowest) --------\n\n";
-    cout<<std::left<<std::setw(5) <<"#"
-            <<std::setw(14)<<"ID"
-            <<std::setw(20)<<"Name"
-            <<std::right<<std::setw(10)<<"Average"
-            <<std::setw(8)<<"Grade"
-            <<"\n";
-    cout<<std::string(5+14+20+10+8, '-')<<'\n';
-    for (int rank=0; rank < studentCount; ++rank)
-    {
-        int i = order[rank];
-        double avg = average(marks[i], testCount);
-        cout<<std::left<<std::setw(5) <<rank+1
-            <<std::setw(14)<<ids[i]
-            <<std::setw(20)<<names[i]
-            <<std::right<<std::setw(10)<<std::fixed<<std::setprecision(2)<<avg
-            <<std::setw(8)<<letterGrade(avg)
-            <<"\n";
-    }
-    cout<<'\n';
+void journalRecord(Journal &j, unsigned char type, const char* payload, std::size_t len)
+{
+    char rec[4 + 1 + 512 + 4];
+    std::uint32_t length = static_cast<std::uint32_t>(1 + len);
+    std::memcpy(rec, &length, 4);
+    rec[4] = static_cast<char>(type);
+    std::memcpy(rec + 5, payload, len);
+    std::uint32_t sum = static_cast<std::uint32_t>(checksum64(rec + 4, length, 0));
+    std::memcpy(rec + 4 + length, &sum, 4);
+    j.append(rec, 4 + length + 4);
 }
 
-//done!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-int main(){
-    cout<<"Student Gradebook Management System (C++)\n";
-    cout<<"-----------------------------------------\n";
-    int testCount = readIntRange("Enter the number of assessments per student (1-8): ", 1, MAX_TESTS);
+void journalAdd(Journal &j, const char* id, const char* name, const Mark* row, int testCount)
+{
+    char payload[1 + ID_LEN + 1 + NAME_LEN + MAX_TESTS];
+    std::size_t n = 0;
+    std::size_t idLen = std::strlen(id), nameLen = std::strlen(name);
+    payload[n++] = static_cast<char>(idLen);
+    std::memcpy(payload + n, id, idLen);
+    n += idLen;
+    payload[n++] = static_cast<char>(nameLen);
+    std::memcpy(payload + n, name, nameLen);
+    n += nameLen;
+    for (int i=0; i<testCount; i++) payload[n++] = static_cast<char>(row[i]);
+    journalRecord(j, JOURNAL_ADD, payload, n);
+}
+
+void journalSet(Journal &j, const char* id, int test, int value)
+{
+    char payload[1 + ID_LEN + 2];
+    std::size_t n = 0;
+    std::size_t idLen = std::strlen(id);
+    payload[n++] = static_cast<char>(idLen);
+    std::memcpy(payload + n, id, idLen);
+    n += idLen;
+    payload[n++] = static_cast<char>(test);
+    payload[n++] = static_cast<char>(value);
+    journalRecord(j, JOURNAL_SET, payload, n);
+}
+
+// Opens (or creates) the journal for appending after it has been replayed.
+// validBytes is where the last intact record ended; anything after it is a torn
+// tail from a crash and is cut off.
+bool openJournal(Journal &j, const char* path, int testCount, std::uint64_t validBytes, std::string &error)
+{
+    j.fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (j.fd < 0)
+    {
+        error = "cannot open file";
+        return false;
+    }
+    if (validBytes < sizeof(JournalHeader))
+    {
+        JournalHeader h{};
+        std::memcpy(h.magic, JOURNAL_MAGIC, sizeof(h.magic));
+        h.version = JOURNAL_VERSION;
+        h.idLen = ID_LEN;
+        h.testCount = testCount;
+        h.checksum = journalHeaderChecksum(h);
+        if (ftruncate(j.fd, 0) != 0 || !writeAll(j.fd, &h, sizeof(h)) || fsync(j.fd) != 0)
+        {
+            error = "cannot write header";
+            return false;
+        }
+    }
+    else if (ftruncate(j.fd, static_cast<off_t>(validBytes)) != 0)
+    {
+        error = "cannot truncate torn tail";
+        return false;
+    }
+    lseek(j.fd, 0, SEEK_END);
+    j.start();
+    return true;
+}
+
+// Empties the journal once its contents are in a fresh snapshot.
+bool resetJournal(Journal &j)
+{
+    //no batch may be in flight while the file is cut back
+    std::unique_lock<std::mutex> held(j.lock);
+    j.drain(held);
+    if (ftruncate(j.fd, sizeof(JournalHeader)) != 0 || fsync(j.fd) != 0) return false;
+    lseek(j.fd, 0, SEEK_END);
+    return true;
+}
+
+// Fixed set of worker threads shared by the parallel kernels. run(tasks, fn)
+// hands fn(0) .. fn(tasks-1) to the workers (the caller helps too) and returns
+// once every task has finished. Runs are serialized; tasks must not call run.
+struct ThreadPool
+{
+    std::vector<std::thread> workers;
+    std::mutex runLock;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* job = nullptr;
+    int nextTask = 0;
+    int taskCount = 0;
+    int unfinished = 0;
+    bool stopping = false;
+
+    explicit ThreadPool(int threads)
+    {
+        for (int i=1; i<threads; i++) workers.emplace_back([this] { loop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> held(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : workers) t.join();
+    }
+
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    void drain(std::unique_lock<std::mutex> &held)
+    {
+        while (nextTask < taskCount)
+        {
+            int task = nextTask++;
+            held.unlock();
+            (*job)(task);
+            held.lock();
+            if (--unfinished == 0) done.notify_all();
+        }
+    }
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> held(lock);
+        while (true)
+        {
+            wake.wait(held, [this] { return stopping || nextTask < taskCount; });
+            if (stopping) return;
+            drain(held);
+        }
+    }
+
+    void run(int tasks, const std::function<void(int)> &fn)
+    {
+        if (tasks <= 0) return;
+        std::lock_guard<std::mutex> serial(runLock);
+        std::unique_lock<std::mutex> held(lock);
+        job = &fn;
+        nextTask = 0;
+        taskCount = tasks;
+        unfinished = tasks;
+        wake.notify_all();
+        drain(held);
+        done.wait(held, [this] { return unfinished == 0; });
+        job = nullptr;
+        taskCount = 0;
+        nextTask = 0;
+    }
+};
+
+// Open-addressing (linear probing) hash index over the ids column.
+// Slots hold row+1 so that 0 means "empty"; the table is kept at most half full.
+struct IdIndex
+{
+    Column<int> slots;
+    int used = 0;
+};
+
+//What a stored mark adds to a sum: itself, or nothing while ungraded. Written
+//as a select so the row loops below still vectorize.
+int markValue(Mark m)
+{
+    return m <= 100 ? m : 0;
+}
+
+//Sum of the graded marks.
+int sumRow(const Mark* row, int tests)
+{
+    int total = 0;
+    for (int i=0; i<tests; i++)
+    {
+        total +=markValue(row[i]);
+    }
+    return total;
+}
+
+int gradedCount(const Mark* row, int tests)
+{
+    int graded = 0;
+    for (int i=0; i<tests; i++)
+    {
+        graded += row[i] <= 100;
+    }
+    return graded;
+}
+
+//Highest graded mark, 0 when none is graded.
+int maxScore(const Mark* row, int tests)
+{
+    int mx = markValue(row[0]);
+    for (int i=1; i<tests; i++)
+    {
+        mx = std::max(mx, markValue(row[i]));
+    }
+    return mx;
+}
+
+//Lowest graded mark, 0 when none is graded. An ungraded byte is above every
+//real mark, so it never wins the min.
+int minScore(const Mark* row, int tests)
+{
+    int mn = row[0];
+    for (int i=1; i<tests; i++)
+    {
+        mn = std::min(mn, int(row[i]));
+    }
+    return mn <= 100 ? mn : 0;
+}
+
+//A mark as the server prints it.
+std::string markText(Mark m)
+{
+    return m == MARK_UNGRADED ? std::string("-") : std::to_string(int(m));
+}
+
+//Prints a mark to cout as a double, like the old double column did, so the
+//current stream state formats it exactly as before.
+void printMark(Mark m)
+{
+    if (m == MARK_UNGRADED) cout<<"-";
+    else cout<<double(m);
+}
+
+//Average over the graded tests; 0 while none is graded.
+double average(const Mark* row, int tests)
+{
+    int graded = gradedCount(row, tests);
+    return graded > 0 ? (double( sumRow(row, tests) ) / double(graded)) : 0.0;
+}
+
+// ---------------- grading schemes ----------------
+// A scheme is a constexpr table of grade bands (lowest average, label), best
+// band first, plus its pass mark. makeScheme expands the bands at compile time
+// into a grade for every average in hundredths, 0.00 to 100.00, so grading an
+// average is a clamp and two table loads with no comparisons against the bands.
+// With whole marks and at most MAX_TESTS assessments, an average below a band
+// edge is at least 0.01 below it, so rounding to hundredths never changes a grade.
+
+const int GRADE_STEPS = 10001; //0.00 .. 100.00 in hundredths
+const int MAX_GRADES = 16;
+
+struct GradeBand
+{
+    int fromCentis; //lowest average in the band, in hundredths
+    const char* label;
+};
+
+struct GradingScheme
+{
+    const char* name;
+    int passCentis;
+    int gradeCount;
+    std::string_view labels[MAX_GRADES];
+    std::uint8_t grade[GRADE_STEPS]; //band index for every average in hundredths
+};
+
+template <std::size_t N>
+constexpr GradingScheme makeScheme(const char* name, int passCentis, const GradeBand (&bands)[N])
+{
+    static_assert(N > 0 && N <= MAX_GRADES, "a scheme needs 1 to MAX_GRADES bands");
+    GradingScheme s{};
+    s.name = name;
+    s.passCentis = passCentis;
+    s.gradeCount = int(N);
+    for (std::size_t b=0; b<N; b++) s.labels[b] = bands[b].label;
+    for (int c=0; c<GRADE_STEPS; c++)
+    {
+        std::size_t b = 0;
+        while (b + 1 < N && c < bands[b].fromCentis) b++;
+        s.grade[c] = std::uint8_t(b);
+    }
+    return s;
+}
+
+constexpr GradeBand PLUS_MINUS_BANDS[] = {
+    {9001, "A+"}, {8500, "A"}, {8000, "A-"}, {7500, "B+"}, {7000, "B"},
+    {6500, "B-"}, {6000, "C+"}, {5000, "C-"}, {0, "F"}
+};
+constexpr GradeBand LETTER_BANDS[] = {
+    {9000, "A"}, {8000, "B"}, {7000, "C"}, {6000, "D"}, {5000, "E"}, {0, "F"}
+};
+
+constexpr GradingScheme PLUS_MINUS_SCHEME = makeScheme("plus-minus", 5000, PLUS_MINUS_BANDS);
+constexpr GradingScheme LETTER_SCHEME = makeScheme("letters", 5000, LETTER_BANDS);
+
+const GradingScheme* const GRADING_SCHEMES[] = { &PLUS_MINUS_SCHEME, &LETTER_SCHEME };
+const GradingScheme* gradingScheme = &PLUS_MINUS_SCHEME; //chosen once at startup (--grading)
+
+const GradingScheme* findGradingScheme(const std::string &name)
+{
+    for (const GradingScheme* s : GRADING_SCHEMES)
+        if (name == s->name) return s;
+    return nullptr;
+}
+
+// An average in hundredths, clamped to the table. min/max compile to minsd/maxsd.
+int averageStep(double avg)
+{
+    double c = std::min(std::max(avg * 100.0 + 0.5, 0.0), double(GRADE_STEPS - 1));
+    return int(c);
+}
+
+//Average of a student with no graded test yet, and of a class without one. Printed
+//as "-"; such a student has no grade, no pass or fail and no rank.
+const double NO_AVERAGE = -1.0;
+
+//Grade under the active scheme; the view points at a string literal, so nothing is allocated.
+std::string_view letterGrade(double avg)
+{
+    if (avg < 0) return "-";
+    const GradingScheme &s = *gradingScheme;
+    return s.labels[s.grade[averageStep(avg)]];
+}
+
+bool passes(double avg)
+{
+    return averageStep(avg) >= gradingScheme->passCentis;
+}
+
+const char* passStatus(double avg)
+{
+    if (avg < 0) return "-";
+    return passes(avg) ? "Pass" : "Fail";
+}
+
+// ---------------- cached aggregates ----------------
+// Every row keeps its total, lowest and highest mark and how many of its tests
+// are graded, all over the graded tests only; its average is total / graded.
+// The class keeps the pass count and its averages in two histograms. A row
+// with every test graded is filed under its total (marks are whole numbers
+// 0..100, so a total is one of 100*testCount+1 values and the histogram is
+// exact); a row with an ungraded test is filed under its average in
+// hundredths (averageStep), the precision averages are printed and graded
+// at. A row with no graded test has no average (NO_AVERAGE) and is only
+// counted in `ungraded`: no histogram, sum, pass count or rank holds it.
+// appendStudent and setMark keep all of it current, so reports never
+// rescan the marks.
+
+struct RowAggregate
+{
+    double total;
+    int low;
+    int high;
+    int graded; //tests with a mark; total, low and high cover only these
+};
+
+struct ClassAggregates
+{
+    std::vector<RowAggregate> rows;       //one per student, same order as the columns
+    std::vector<int> totalCounts;         //fully graded students per total, 0..100*testCount
+    std::vector<int> partialCounts;       //the others per average step, 0..GRADE_STEPS-1
+    std::vector<long long> partialTotals; //the others' totals summed per graded count, 0..testCount-1
+    std::vector<int> markCounts;          //graded marks per (test, mark): test*101 + mark
+    long long totalSum = 0;               //sum of the fully graded students' totals
+    int passCount = 0;
+    int ungraded = 0;                     //students with no graded test
+    int bestTotal = -1;                   //highest total with a student, -1 when none
+    int worstTotal = -1;                  //lowest total with a student
+    int bestStep = -1;                    //the same over partialCounts
+    int worstStep = -1;
+};
+
+double rowAverage(const RowAggregate &ra)
+{
+    return ra.graded > 0 ? ra.total / ra.graded : NO_AVERAGE;
+}
+
+RowAggregate rowAggregate(const Mark* row, int tests)
+{
+    return {double(sumRow(row, tests)), minScore(row, tests), maxScore(row, tests), gradedCount(row, tests)};
+}
+
+// Histogram bucket of a total, clamped so an out-of-range snapshot can't index outside it.
+int totalBucket(const ClassAggregates &agg, double total)
+{
+    int bucket = int(total);
+    if (bucket < 0) bucket = 0;
+    if (bucket >= int(agg.totalCounts.size())) bucket = int(agg.totalCounts.size()) - 1;
+    return bucket;
+}
+
+// One more student in counts[bucket]; best and worst follow the occupied ends.
+void fileBucket(std::vector<int> &counts, int bucket, int &best, int &worst)
+{
+    ++counts[bucket];
+    if (best < 0 || bucket > best) best = bucket;
+    if (worst < 0 || bucket < worst) worst = bucket;
+}
+
+// Removing the last student at the best or worst bucket walks the histogram to
+// the next occupied one; over any run of updates that walk is amortized.
+void unfileBucket(std::vector<int> &counts, int bucket, int &best, int &worst)
+{
+    if (--counts[bucket] > 0) return;
+    int top = int(counts.size()) - 1;
+    while (best >= 0 && counts[best] == 0) --best;
+    while (worst >= 0 && worst <= top && counts[worst] == 0) ++worst;
+    if (best < 0) worst = -1;
+}
+
+void countTotal(ClassAggregates &agg, int testCount, const RowAggregate &ra)
+{
+    if (ra.graded == 0)
+    {
+        agg.ungraded++;
+        return;
+    }
+    double avg = rowAverage(ra);
+    if (passes(avg)) ++agg.passCount;
+    if (ra.graded == testCount)
+    {
+        fileBucket(agg.totalCounts, totalBucket(agg, ra.total), agg.bestTotal, agg.worstTotal);
+        agg.totalSum += (long long)ra.total;
+    }
+    else
+    {
+        fileBucket(agg.partialCounts, averageStep(avg), agg.bestStep, agg.worstStep);
+        agg.partialTotals[ra.graded] += (long long)ra.total;
+    }
+}
+
+void uncountTotal(ClassAggregates &agg, int testCount, const RowAggregate &ra)
+{
+    if (ra.graded == 0)
+    {
+        agg.ungraded--;
+        return;
+    }
+    double avg = rowAverage(ra);
+    if (passes(avg)) --agg.passCount;
+    if (ra.graded == testCount)
+    {
+        unfileBucket(agg.totalCounts, totalBucket(agg, ra.total), agg.bestTotal, agg.worstTotal);
+        agg.totalSum -= (long long)ra.total;
+    }
+    else
+    {
+        unfileBucket(agg.partialCounts, averageStep(avg), agg.bestStep, agg.worstStep);
+        agg.partialTotals[ra.graded] -= (long long)ra.total;
+    }
+}
+
+// Mark histogram bucket of a graded mark.
+int markBucket(int test, Mark mark)
+{
+    return test * 101 + mark;
+}
+
+// Adds (delta 1) or removes (delta -1) one student's graded marks from the per-test histograms.
+void countMarks(ClassAggregates &agg, const Mark* row, int tests, int delta)
+{
+    for (int t=0; t<tests; t++)
+        if (row[t] <= 100) agg.markCounts[markBucket(t, row[t])] += delta;
+}
+
+// Highest and lowest average in the class, NO_AVERAGE when nobody is graded.
+double bestAverage(const ClassAggregates &agg, int testCount)
+{
+    double best = agg.bestTotal >= 0 ? double(agg.bestTotal) / testCount : NO_AVERAGE;
+    return agg.bestStep >= 0 ? std::max(best, agg.bestStep / 100.0) : best;
+}
+
+double worstAverage(const ClassAggregates &agg, int testCount)
+{
+    double worst = agg.worstTotal >= 0 ? double(agg.worstTotal) / testCount : 100.0;
+    if (agg.worstStep >= 0) worst = std::min(worst, agg.worstStep / 100.0);
+    return agg.worstTotal >= 0 || agg.worstStep >= 0 ? worst : NO_AVERAGE;
+}
+
+// Mean of the students' averages over the `students` graded rows. The partially graded
+// rows are summed from their exact totals, not from the rounded average steps
+// they are filed under.
+double classAverage(const ClassAggregates &agg, int testCount, int students)
+{
+    if (students <= 0) return NO_AVERAGE;
+    double sum = double(agg.totalSum) / testCount;
+    for (int graded=1; graded<int(agg.partialTotals.size()); graded++) sum += double(agg.partialTotals[graded]) / graded;
+    return sum / students;
+}
+
+// ---------------- concurrent readers ----------------
+// Reports may run on other threads while a single writer keeps changing the
+// class. Once enableSharedReads() is called:
+//  - setMark rewrites a row inside that row's seqlock, so a reader that copies
+//    the row and sees the same even sequence before and after has either all
+//    of an update or none of it;
+//  - the class totals and the visible row count sit behind a second seqlock;
+//  - a column that has to grow is copied, the new buffers are published as a
+//    fresh ReadView and the old ones are retired, to be freed once every
+//    reader that entered before the switch has left (epoch based reclamation,
+//    as in RCU).
+// Readers take no locks and never wait for the writer.
+
+struct ReaderSlot
+{
+    std::atomic<std::uint64_t> epoch{0}; //epoch the thread entered at, 0 outside a ReadGuard
+    int depth = 0;                       //nested ReadGuards; touched by the owning thread only
+};
+
+struct EpochRegistry
+{
+    std::atomic<std::uint64_t> epoch{1};
+    std::mutex lock;
+    std::vector<std::unique_ptr<ReaderSlot>> slots; //one per thread that ever read
+};
+
+EpochRegistry& epochRegistry()
+{
+    static EpochRegistry reg;
+    return reg;
+}
+
+ReaderSlot& threadReaderSlot()
+{
+    thread_local ReaderSlot* slot = nullptr;
+    if (!slot)
+    {
+        EpochRegistry &reg = epochRegistry();
+        std::lock_guard<std::mutex> held(reg.lock);
+        reg.slots.emplace_back(new ReaderSlot());
+        slot = reg.slots.back().get();
+    }
+    return *slot;
+}
+
+// Every pointer a reader follows, published together.
+struct ReadView
+{
+    const char* ids;
+    const std::uint64_t* idKeys;
+    const std::uint32_t* nameOffsets;
+    const char* namePool;
+    const Mark* marks;
+    const RowAggregate* rows;
+    const int* indexSlots;
+    std::size_t indexMask;
+    std::atomic<std::uint32_t>* rowSeq;
+};
+
+struct SharedReads
+{
+    std::atomic<const ReadView*> view{nullptr};
+    std::atomic<int> visible{0};            //rows readers may look at
+    std::atomic<std::uint32_t> classSeq{0}; //guards the class totals and visible
+    std::shared_ptr<std::atomic<std::uint32_t>> rowSeq; //one sequence per reserved row
+    std::shared_ptr<ReadView> current;      //what view points at
+    std::vector<std::shared_ptr<void>> pending;  //buffers replaced since the last publish
+    std::vector<std::pair<std::uint64_t, std::shared_ptr<void>>> retired; //(epoch, buffer)
+};
+
+// Marks the calling thread as reading; whatever it loads from the published
+// view stays allocated until the guard goes away. Does nothing without shared reads.
+struct ReadGuard
+{
+    ReaderSlot* slot = nullptr;
+
+    explicit ReadGuard(const SharedReads* shared)
+    {
+        if (!shared) return;
+        slot = &threadReaderSlot();
+        if (slot->depth++ == 0) slot->epoch.store(epochRegistry().epoch.load());
+    }
+
+    ~ReadGuard()
+    {
+        if (slot && --slot->depth == 0) slot->epoch.store(0, std::memory_order_release);
+    }
+};
+
+void seqBegin(std::atomic<std::uint32_t> &seq)
+{
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void seqEnd(std::atomic<std::uint32_t> &seq)
+{
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Runs copy until it completes without the writer inside seq; returns the retries.
+template <typename Fn>
+int seqRead(const std::atomic<std::uint32_t> &seq, Fn copy)
+{
+    for (int retries=0; ; retries++)
+    {
+        std::uint32_t before = seq.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            if (retries >= 64) std::this_thread::yield(); //the writer may be descheduled mid-update
+            continue;
+        }
+        copy();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == before) return retries;
+    }
+}
+
+// Order-statistic treap over the rows, see "rank index". One node per row,
+// holding everything but the id tie-break, so a step down the tree is one
+// cache miss.
+struct RankNode
+{
+    int left;  //-1 is no child
+    int right;
+    int size;   //rows in this subtree
+    double avg; //the average the row is filed under
+};
+
+struct RankIndex
+{
+    std::vector<RankNode> nodes;
+    int root = -1;
+    bool built = false; //built on first use, kept current after that
+};
+
+// Case-folded names for searching, see "name index".
+struct NameIndex
+{
+    std::string folded;                //lower-case names, NUL terminated, in row order
+    std::vector<std::uint32_t> starts; //where each row's name starts in folded
+    std::vector<int> sorted;           //rows by folded name, then id
+    std::vector<int> recent;           //rows added since the last merge, in the same order
+    bool built = false;                //built by the first search, kept current after that
+};
+
+// Column-oriented student store. Each column is one contiguous block that
+// grows geometrically, so there is no class size limit and nothing large
+// lives on the stack.
+struct Gradebook
+{
+    int testCount = 0;
+    int studentCount = 0;
+    int capacity = 0;                  //rows reserved in every column
+    Column<char> ids;                  //ID_LEN bytes per row, NUL padded
+    Column<std::uint64_t> idKeys;      //packId of every id, see "packed id keys"
+    Column<std::uint32_t> nameOffsets; //start of each name in namePool
+    Column<char> namePool;             //NUL terminated names, back to back
+    Column<Mark> marks;                //testCount per row, row-major
+    IdIndex index;
+    ClassAggregates agg;               //totals, min/max and class stats, see below
+    RankIndex rank;                    //order statistics over agg.rows, see "rank index"
+    NameIndex names;                   //name search, see "name index"
+    std::vector<std::uint8_t> testColumns; //column-major byte copy of marks, see testColumns()
+    bool testColumnsStale = true;      //set by appendStudent
+    std::shared_ptr<MappedFile> snapshot; //set when the columns come from --snapshot
+    Journal* journal = nullptr;           //mutations are logged here when set
+    ThreadPool* pool = nullptr;           //parallel kernels run here when set
+    std::shared_ptr<SharedReads> shared;  //set by enableSharedReads, see above
+};
+
+// With shared reads on, the const accessors go through the published view;
+// for the writer those are the same buffers it just published.
+const char* studentId(const Gradebook &gb, int row)
+{
+    const char* ids = gb.shared ? gb.shared->view.load()->ids : gb.ids.data();
+    return ids + std::size_t(row) * ID_LEN;
+}
+
+std::uint64_t idKey(const Gradebook &gb, int row)
+{
+    const std::uint64_t* keys = gb.shared ? gb.shared->view.load()->idKeys : gb.idKeys.data();
+    return keys[row];
+}
+
+const char* studentName(const Gradebook &gb, int row)
+{
+    if (!gb.shared) return gb.namePool.data() + gb.nameOffsets[row];
+    const ReadView* v = gb.shared->view.load();
+    return v->namePool + v->nameOffsets[row];
+}
+
+const Mark* studentRow(const Gradebook &gb, int row)
+{
+    const Mark* marks = gb.shared ? gb.shared->view.load()->marks : gb.marks.data();
+    return marks + std::size_t(row) * gb.testCount;
+}
+
+Mark* studentRow(Gradebook &gb, int row)
+{
+    return gb.marks.own().data() + std::size_t(row) * gb.testCount;
+}
+
+// Frees the retired buffers that no reader can still hold: those retired
+// before the epoch the oldest active reader entered at.
+void reclaimRetired(SharedReads &shared)
+{
+    std::uint64_t oldest = UINT64_MAX;
+    {
+        EpochRegistry &reg = epochRegistry();
+        std::lock_guard<std::mutex> held(reg.lock);
+        for (const std::unique_ptr<ReaderSlot> &slot : reg.slots)
+        {
+            std::uint64_t e = slot->epoch.load();
+            if (e != 0 && e < oldest) oldest = e;
+        }
+    }
+    auto freeable = [oldest](const std::pair<std::uint64_t, std::shared_ptr<void>> &r) { return r.first < oldest; };
+    shared.retired.erase(std::remove_if(shared.retired.begin(), shared.retired.end(), freeable), shared.retired.end());
+}
+
+// Points readers at the current buffers, then retires whatever they replaced.
+// The writer calls this after every regrow and before anything it wrote into
+// the new buffers becomes visible.
+void publishView(const Gradebook &gb)
+{
+    SharedReads &shared = *gb.shared;
+    if (shared.current && shared.pending.empty()) return;
+    std::shared_ptr<ReadView> v = std::make_shared<ReadView>();
+    v->ids = gb.ids.data();
+    v->idKeys = gb.idKeys.data();
+    v->nameOffsets = gb.nameOffsets.data();
+    v->namePool = gb.namePool.data();
+    v->marks = gb.marks.data();
+    v->rows = gb.agg.rows.data();
+    v->indexSlots = gb.index.slots.data();
+    v->indexMask = gb.index.slots.size() - 1;
+    v->rowSeq = shared.rowSeq.get();
+    shared.view.store(v.get());
+    if (shared.current) shared.pending.push_back(shared.current);
+    shared.current = v;
+    //a reader that enters after this increment can only load the new view
+    std::uint64_t retiredAt = epochRegistry().epoch.fetch_add(1);
+    for (std::shared_ptr<void> &old : shared.pending) shared.retired.emplace_back(retiredAt, std::move(old));
+    shared.pending.clear();
+    reclaimRetired(shared);
+}
+
+// Grows v to at least cap elements. With shared reads on, the old buffer is
+// kept for readers that may still be using it instead of being freed.
+template <typename T>
+void reserveColumn(const Gradebook &gb, std::vector<T> &v, std::size_t cap)
+{
+    if (cap <= v.capacity()) return;
+    if (!gb.shared)
+    {
+        v.reserve(cap);
+        return;
+    }
+    std::vector<T> grown;
+    grown.reserve(cap);
+    grown.assign(v.begin(), v.end());
+    v.swap(grown);
+    gb.shared->pending.push_back(std::make_shared<std::vector<T>>(std::move(grown)));
+}
+
+void reserveRowSeq(SharedReads &shared, int oldCap, int cap)
+{
+    std::shared_ptr<std::atomic<std::uint32_t>> seq(new std::atomic<std::uint32_t>[cap](), std::default_delete<std::atomic<std::uint32_t>[]>());
+    for (int i=0; i<oldCap; i++) seq.get()[i].store(shared.rowSeq.get()[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if (shared.rowSeq) shared.pending.push_back(shared.rowSeq);
+    shared.rowSeq = seq;
+}
+
+// Rows a reader may look at; the writer's own count without shared reads.
+int visibleStudents(const Gradebook &gb)
+{
+    return gb.shared ? gb.shared->visible.load(std::memory_order_acquire) : gb.studentCount;
+}
+
+RowAggregate readAggregate(const Gradebook &gb, int row)
+{
+    if (!gb.shared) return gb.agg.rows[row];
+    const ReadView* v = gb.shared->view.load();
+    RowAggregate ra;
+    seqRead(v->rowSeq[row], [&] { ra = v->rows[row]; });
+    return ra;
+}
+
+// Copies one student's marks and aggregate as of a single moment; returns the retries.
+int readStudent(const Gradebook &gb, int row, Mark* marks, RowAggregate &ra)
+{
+    if (!gb.shared)
+    {
+        std::memcpy(marks, studentRow(gb, row), sizeof(Mark) * gb.testCount);
+        ra = gb.agg.rows[row];
+        return 0;
+    }
+    const ReadView* v = gb.shared->view.load();
+    const Mark* src = v->marks + std::size_t(row) * gb.testCount;
+    return seqRead(v->rowSeq[row], [&]
+    {
+        std::memcpy(marks, src, sizeof(Mark) * gb.testCount);
+        ra = v->rows[row];
+    });
+}
+
+// The class-wide figures of the summary, taken together.
+struct ClassTotals
+{
+    int students;
+    int graded;    //students with a graded test; the figures below cover only these
+    int passCount;
+    double classAvg;
+    double bestAvg;
+    double worstAvg;
+};
+
+ClassTotals readClassTotals(const Gradebook &gb)
+{
+    const ClassAggregates &agg = gb.agg;
+    int tests = gb.testCount;
+    ClassTotals t;
+    auto copy = [&]
+    {
+        int students = visibleStudents(gb);
+        int graded = students - agg.ungraded;
+        t = {students, graded, agg.passCount, classAverage(agg, tests, graded), bestAverage(agg, tests), worstAverage(agg, tests)};
+    };
+    if (gb.shared) seqRead(gb.shared->classSeq, copy);
+    else copy();
+    return t;
+}
+
+// Copies the average and per-test mark histograms together.
+void readHistograms(const Gradebook &gb, std::vector<int> &totals, std::vector<int> &partial, std::vector<int> &marks)
+{
+    const ClassAggregates &agg = gb.agg;
+    totals.resize(agg.totalCounts.size());
+    partial.resize(agg.partialCounts.size());
+    marks.resize(agg.markCounts.size());
+    auto copy = [&]
+    {
+        std::copy(agg.totalCounts.begin(), agg.totalCounts.end(), totals.begin());
+        std::copy(agg.partialCounts.begin(), agg.partialCounts.end(), partial.begin());
+        std::copy(agg.markCounts.begin(), agg.markCounts.end(), marks.begin());
+    };
+    if (gb.shared) seqRead(gb.shared->classSeq, copy);
+    else copy();
+}
+
+// ---------------- packed id keys ----------------
+// Every id is also kept as one 64-bit key in gb.idKeys. An id of "ets" and up
+// to 12 digits or lowercase letters packs whole: the prefix is implied and the
+// suffix is read as a base-37 number, first character most significant, where
+// 0 pads a short suffix and 1-36 are 0-9 then a-z. Padding sorts before every
+// character and the digits keep ascii order, so packed keys compare exactly
+// like strcmp on the ids: the index, the ranking tie-breaks and the by-id
+// listing compare integers. Anything else (an id from --import or a journal
+// that does not fit) gets ID_KEY_FALLBACK plus a hash of its text, and
+// compareIds and findStudentById go back to the id column for those.
+
+const std::uint64_t ID_KEY_FALLBACK = 1ULL << 63;
+const int ID_KEY_DIGITS = 12; //37^12 < 2^63
+const std::uint64_t ID_KEY_LIMIT = 6582952005840035281ULL; //37^12, above every packed key
+
+unsigned long long hashId(const char* id)
+{
+    //FNV-1a over the normalized (lowercase) id
+    unsigned long long h = 1469598103934665603ULL;
+    for (; *id; ++id)
+    {
+        h ^= static_cast<unsigned char>(*id);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::uint64_t fallbackKey(const char* id)
+{
+    return ID_KEY_FALLBACK | hashId(id) >> 1;
+}
+
+std::uint64_t packId(const char* id)
+{
+    if (std::strncmp(id, "ets", 3) != 0) return fallbackKey(id);
+    const char* p = id + 3;
+    std::uint64_t key = 0;
+    for (int i=0; i<ID_KEY_DIGITS; i++)
+    {
+        int digit = 0;
+        if (*p >= '0' && *p <= '9') digit = *p++ - '0' + 1;
+        else if (*p >= 'a' && *p <= 'z') digit = *p++ - 'a' + 11;
+        else if (*p != '\0') return fallbackKey(id);
+        key = key * 37 + digit;
+    }
+    return *p ? fallbackKey(id) : key;
+}
+
+// strcmp of two students' ids, which may be in different gradebooks.
+int compareIds(const Gradebook &ga, int a, const Gradebook &gb, int b)
+{
+    std::uint64_t ka = idKey(ga, a), kb = idKey(gb, b);
+    if (!((ka | kb) & ID_KEY_FALLBACK)) return ka < kb ? -1 : ka > kb;
+    return std::strcmp(studentId(ga, a), studentId(gb, b));
+}
+
+// Slot of a key in the id index (the splitmix64 finalizer).
+unsigned long long hashKey(std::uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+}
+
+void idIndexRehash(IdIndex &index, const Gradebook &gb, std::size_t newSize)
+{
+    std::vector<int> old;
+    old.swap(index.slots.own());
+    std::vector<int> &slots = index.slots.own();
+    slots.assign(newSize, 0);
+    std::size_t mask = newSize - 1;
+    for (int slot : old)
+    {
+        if (slot == 0) continue;
+        std::size_t pos = hashKey(idKey(gb, slot-1)) & mask;
+        while (slots[pos] != 0) pos = (pos + 1) & mask;
+        slots[pos] = slot;
+    }
+    //readers may still be probing the old table
+    if (gb.shared) gb.shared->pending.push_back(std::make_shared<std::vector<int>>(std::move(old)));
+}
+
+// idKey(gb, row) must already hold the new id's key.
+void idIndexInsert(IdIndex &index, const Gradebook &gb, int row)
+{
+    if (index.slots.empty() || std::size_t(index.used + 1) * 2 > index.slots.size())
+    {
+        idIndexRehash(index, gb, index.slots.empty() ? 64 : index.slots.size() * 2);
+        if (gb.shared) publishView(gb);
+    }
+    std::vector<int> &slots = index.slots.own();
+    std::size_t mask = slots.size() - 1;
+    std::size_t pos = hashKey(idKey(gb, row)) & mask;
+    while (slots[pos] != 0) pos = (pos + 1) & mask;
+    __atomic_store_n(&slots[pos], row + 1, __ATOMIC_RELEASE); //readers may be probing
+    ++index.used;
+}
+
+int findStudentById(const Gradebook &gb, const char* id)
+{
+    OpTimer timer(STAT_FIND_ID);
+    const IdIndex &index = gb.index;
+    const ReadView* v = gb.shared ? gb.shared->view.load() : nullptr;
+    if (!v && index.slots.empty()) return -1;
+    const int* slots = v ? v->indexSlots : index.slots.data();
+    const std::uint64_t* keys = v ? v->idKeys : gb.idKeys.data();
+    std::size_t mask = v ? v->indexMask : index.slots.size() - 1;
+    std::uint64_t key = packId(id);
+    for (std::size_t pos = hashKey(key) & mask; ; pos = (pos + 1) & mask)
+    {
+        int slot = __atomic_load_n(&slots[pos], __ATOMIC_ACQUIRE);
+        if (slot == 0) break;
+        int row = slot - 1;
+        if (keys[row] == key && (!(key & ID_KEY_FALLBACK) || std::strcmp(studentId(gb, row), id)==0)) return row;
+    }
+    return -1; //stud not found!
+}
+
+// Plain scan, kept as the baseline for --bench-lookup.
+int findStudentByIdLinear(const Gradebook &gb, const char* id)
+{
+    for(int i=0; i< gb.studentCount; i++)
+        {
+            if (std::strcmp(studentId(gb, i), id)==0) return i;
+        }
+    return -1; //stud not found!
+}
+
+// The first n rows in id order. Packed keys go through an LSD radix sort, one
+// byte per pass, skipping the bytes all of them share (for ets ids that is
+// most of the high ones); rows whose id did not pack are sorted on the text
+// and merged in.
+std::vector<int> idOrder(const Gradebook &gb, int n)
+{
+    OpTimer timer(STAT_ID_SORT);
+    std::vector<std::uint64_t> keys, keysTmp;
+    std::vector<int> rows, rowsTmp, fallback;
+    keys.reserve(n);
+    rows.reserve(n);
+    for (int i=0; i<n; i++)
+    {
+        std::uint64_t key = idKey(gb, i);
+        if (key & ID_KEY_FALLBACK) fallback.push_back(i);
+        else
+        {
+            keys.push_back(key);
+            rows.push_back(i);
+        }
+    }
+
+    std::size_t m = keys.size();
+    std::vector<std::size_t> counts(8 * 256, 0);
+    for (std::uint64_t key : keys)
+        for (int b=0; b<8; b++) counts[b*256 + ((key >> (8*b)) & 0xff)]++;
+    keysTmp.resize(m);
+    rowsTmp.resize(m);
+    for (int b=0; b<8; b++)
+    {
+        std::size_t* count = &counts[b*256];
+        if (m == 0 || count[(keys[0] >> (8*b)) & 0xff] == m) continue; //every key has this byte
+        std::size_t sum = 0;
+        for (int d=0; d<256; d++)
+        {
+            std::size_t c = count[d];
+            count[d] = sum;
+            sum += c;
+        }
+        for (std::size_t i=0; i<m; i++)
+        {
+            std::size_t to = count[(keys[i] >> (8*b)) & 0xff]++;
+            keysTmp[to] = keys[i];
+            rowsTmp[to] = rows[i];
+        }
+        keys.swap(keysTmp);
+        rows.swap(rowsTmp);
+    }
+    if (fallback.empty()) return rows;
+
+    auto before = [&gb](int a, int b) { return compareIds(gb, a, gb, b) < 0; };
+    std::sort(fallback.begin(), fallback.end(), before);
+    std::vector<int> order(n);
+    std::merge(rows.begin(), rows.end(), fallback.begin(), fallback.end(), order.begin(), before);
+    return order;
+}
+
+// Makes room for at least `rows` students, doubling the capacity of every column.
+void reserveStudents(Gradebook &gb, int rows)
+{
+    if (rows <= gb.capacity) return;
+    int cap = gb.capacity > 0 ? gb.capacity : 16;
+    while (cap < rows) cap = cap > (1 << 29) ? rows : cap * 2;
+    reserveColumn(gb, gb.ids.own(), std::size_t(cap) * ID_LEN);
+    reserveColumn(gb, gb.idKeys.own(), cap);
+    reserveColumn(gb, gb.nameOffsets.own(), cap);
+    reserveColumn(gb, gb.marks.own(), std::size_t(cap) * gb.testCount);
+    reserveColumn(gb, gb.agg.rows, cap);
+    if (gb.shared)
+    {
+        reserveRowSeq(*gb.shared, gb.capacity, cap);
+        publishView(gb);
+    }
+    gb.capacity = cap;
+}
+
+// ---------------- parallel reductions ----------------
+// Full passes over the class (rebuilding the aggregates, transposing and
+// scanning the test columns) are split into fixed row ranges on the thread
+// pool. Each range folds into its own accumulator and the partials are merged
+// in range order; every sum is an exact integer, so the result is identical
+// for any --threads value. Small classes take the serial path.
+
+const int PARALLEL_MIN_ROWS = 1 << 16; //below this the serial path is faster
+
+// Splits [0, n) into `parts` nearly equal ranges; range t is [bounds[t], bounds[t+1]).
+std::vector<int> splitRows(int n, int parts)
+{
+    std::vector<int> bounds(parts + 1);
+    for (int t=0; t<=parts; t++) bounds[t] = static_cast<int>(static_cast<long long>(n) * t / parts);
+    return bounds;
+}
+
+int parallelParts(const Gradebook &gb, int n)
+{
+    if (!gb.pool || gb.pool->size() == 1 || n < PARALLEL_MIN_ROWS) return 1;
+    int parts = 1;
+    while (parts < gb.pool->size()) parts *= 2; //power of two keeps the merge tree simple
+    return parts;
+}
+
+// Folds rows [begin, end) into part: fills their RowAggregate in rows and counts their totals.
+// Reads through the const accessors so borrowed snapshot columns are not copied.
+void foldAggregates(const Gradebook &gb, std::vector<RowAggregate> &rows, int begin, int end, ClassAggregates &part)
+{
+    part.totalCounts.assign(std::size_t(100) * gb.testCount + 1, 0);
+    part.partialCounts.assign(GRADE_STEPS, 0);
+    part.partialTotals.assign(gb.testCount, 0);
+    part.markCounts.assign(std::size_t(101) * gb.testCount, 0);
+    for (int i=begin; i<end; i++)
+    {
+        const Mark* row = studentRow(gb, i);
+        rows[i] = rowAggregate(row, gb.testCount);
+        countTotal(part, gb.testCount, rows[i]);
+        countMarks(part, row, gb.testCount, 1);
+    }
+}
+
+void mergeExtremes(int &best, int &worst, int partBest, int partWorst)
+{
+    if (partBest > best) best = partBest;
+    if (partWorst >= 0 && (worst < 0 || partWorst < worst)) worst = partWorst;
+}
+
+void mergeAggregates(ClassAggregates &into, const ClassAggregates &part)
+{
+    for (std::size_t b=0; b<into.totalCounts.size(); b++) into.totalCounts[b] += part.totalCounts[b];
+    for (std::size_t b=0; b<into.partialCounts.size(); b++) into.partialCounts[b] += part.partialCounts[b];
+    for (std::size_t b=0; b<into.markCounts.size(); b++) into.markCounts[b] += part.markCounts[b];
+    for (std::size_t g=0; g<into.partialTotals.size(); g++) into.partialTotals[g] += part.partialTotals[g];
+    into.totalSum += part.totalSum;
+    into.passCount += part.passCount;
+    into.ungraded += part.ungraded;
+    mergeExtremes(into.bestTotal, into.worstTotal, part.bestTotal, part.worstTotal);
+    mergeExtremes(into.bestStep, into.worstStep, part.bestStep, part.worstStep);
+}
+
+// Recomputes every aggregate from the marks column; used after --snapshot
+// maps the columns in, everything later is kept current incrementally.
+void rebuildAggregates(Gradebook &gb)
+{
+    OpTimer timer(STAT_AGGREGATES);
+    ClassAggregates &agg = gb.agg;
+    agg = ClassAggregates();
+    agg.totalCounts.assign(std::size_t(100) * gb.testCount + 1, 0);
+    agg.partialCounts.assign(GRADE_STEPS, 0);
+    agg.partialTotals.assign(gb.testCount, 0);
+    agg.markCounts.assign(std::size_t(101) * gb.testCount, 0);
+    agg.rows.reserve(gb.capacity);
+    agg.rows.resize(gb.studentCount);
+
+    int parts = parallelParts(gb, gb.studentCount);
+    std::vector<int> bounds = splitRows(gb.studentCount, parts);
+    std::vector<ClassAggregates> partial(parts);
+    auto fold = [&](int t) { foldAggregates(gb, agg.rows, bounds[t], bounds[t + 1], partial[t]); };
+    if (parts == 1) fold(0);
+    else gb.pool->run(parts, fold);
+    for (const ClassAggregates &part : partial) mergeAggregates(agg, part);
+}
+
+// Sets the class-wide sums, pass count and extremes from the histograms alone,
+// for aggregates read back from a snapshot. The pass count is recounted here
+// rather than stored, since it depends on --grading. The partially graded
+// rows' exact totals and the ungraded count are not in any histogram; they
+// take one pass over the stored row aggregates.
+void summarizeHistograms(ClassAggregates &agg, int testCount)
+{
+    agg.totalSum = 0;
+    agg.ungraded = 0;
+    agg.partialTotals.assign(testCount, 0);
+    for (const RowAggregate &ra : agg.rows)
+    {
+        if (ra.graded == 0) agg.ungraded++;
+        else if (ra.graded < testCount) agg.partialTotals[ra.graded] += (long long)ra.total;
+    }
+    agg.passCount = 0;
+    agg.bestTotal = agg.worstTotal = agg.bestStep = agg.worstStep = -1;
+    for (int total=0; total<int(agg.totalCounts.size()); total++)
+    {
+        int count = agg.totalCounts[total];
+        if (count == 0) continue;
+        agg.totalSum += (long long)total * count;
+        if (passes(double(total) / testCount)) agg.passCount += count;
+        if (agg.worstTotal < 0) agg.worstTotal = total;
+        agg.bestTotal = total;
+    }
+    for (int step=0; step<int(agg.partialCounts.size()); step++)
+    {
+        int count = agg.partialCounts[step];
+        if (count == 0) continue;
+        if (step >= gradingScheme->passCentis) agg.passCount += count;
+        if (agg.worstStep < 0) agg.worstStep = step;
+        agg.bestStep = step;
+    }
+}
+
+// ---------------- name index ----------------
+// Every name is folded to lower case once, into one NUL separated pool in row
+// order. A prefix search is a binary search over the rows sorted by folded
+// name; a substring search runs memmem over the whole pool, so it reads the
+// names at memory speed, and maps each hit back to its row with a binary
+// search over the starts. appendStudent folds the new name and inserts the row
+// into `recent`, a second sorted run that is merged into `sorted` once it
+// holds a sixteenth as many rows, so an add moves a short run and a search is
+// two binary searches. Results come in name order, id breaking ties, cut to
+// the first `limit`. Like the rank index it is built by the first search and
+// only the writer's thread uses it.
+
+const std::size_t NAME_MERGE_MIN = 1024; //recent rows before a merge is worth it
+
+const char* foldedName(const NameIndex &ni, int row)
+{
+    return ni.folded.data() + ni.starts[row];
+}
+
+bool nameBefore(const Gradebook &gb, int a, int b)
+{
+    int byName = std::strcmp(foldedName(gb.names, a), foldedName(gb.names, b));
+    return byName != 0 ? byName < 0 : compareIds(gb, a, gb, b) < 0;
+}
+
+void foldName(NameIndex &ni, const char* name)
+{
+    ni.starts.push_back(static_cast<std::uint32_t>(ni.folded.size()));
+    for (; *name; ++name) ni.folded += static_cast<char>(std::tolower(static_cast<unsigned char>(*name)));
+    ni.folded += '\0';
+}
+
+void buildNameIndex(Gradebook &gb)
+{
+    NameIndex &ni = gb.names;
+    ni = NameIndex();
+    ni.starts.reserve(gb.capacity);
+    for (int i=0; i<gb.studentCount; i++) foldName(ni, studentName(gb, i));
+    ni.sorted.resize(gb.studentCount);
+    for (int i=0; i<gb.studentCount; i++) ni.sorted[i] = i;
+    std::sort(ni.sorted.begin(), ni.sorted.end(), [&gb](int a, int b) { return nameBefore(gb, a, b); });
+    ni.built = true;
+}
+
+// Called by appendStudent once the row is in; nothing to do before the first search.
+void nameIndexAdd(Gradebook &gb, int row, const char* name)
+{
+    NameIndex &ni = gb.names;
+    if (!ni.built) return;
+    foldName(ni, name);
+    auto before = [&gb](int a, int b) { return nameBefore(gb, a, b); };
+    ni.recent.insert(std::upper_bound(ni.recent.begin(), ni.recent.end(), row, before), row);
+    if (ni.recent.size() < std::max(NAME_MERGE_MIN, ni.sorted.size() / 16)) return;
+    std::size_t mid = ni.sorted.size();
+    ni.sorted.insert(ni.sorted.end(), ni.recent.begin(), ni.recent.end());
+    std::inplace_merge(ni.sorted.begin(), ni.sorted.begin() + mid, ni.sorted.end(), before);
+    ni.recent.clear();
+}
+
+// The rows of run whose folded name starts with prefix, as [first, last).
+void prefixRange(const NameIndex &ni, const std::vector<int> &run, const std::string &prefix,
+                 std::vector<int>::const_iterator &first, std::vector<int>::const_iterator &last)
+{
+    first = std::partition_point(run.begin(), run.end(),
+        [&](int row) { return std::strcmp(foldedName(ni, row), prefix.c_str()) < 0; });
+    last = std::partition_point(first, run.end(),
+        [&](int row) { return std::strncmp(foldedName(ni, row), prefix.c_str(), prefix.size()) == 0; });
+}
+
+// Students whose name starts with (or, with substring, contains) text, any
+// case, in name order and at most limit of them. matches receives how many
+// there are in all.
+std::vector<int> searchNames(Gradebook &gb, const char* text, bool substring, int limit, int &matches)
+{
+    OpTimer timer(STAT_NAME_SEARCH);
+    NameIndex &ni = gb.names;
+    if (!ni.built) buildNameIndex(gb);
+    std::string key(text);
+    for (char &c : key) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    auto before = [&gb](int a, int b) { return nameBefore(gb, a, b); };
+    std::vector<int> rows;
+
+    if (!substring)
+    {
+        std::vector<int>::const_iterator s, sEnd, r, rEnd;
+        prefixRange(ni, ni.sorted, key, s, sEnd);
+        prefixRange(ni, ni.recent, key, r, rEnd);
+        matches = int((sEnd - s) + (rEnd - r));
+        while (int(rows.size()) < limit && (s != sEnd || r != rEnd))
+        {
+            if (r == rEnd || (s != sEnd && before(*s, *r))) rows.push_back(*s++);
+            else rows.push_back(*r++);
+        }
+        return rows;
+    }
+
+    const char* pool = ni.folded.data();
+    std::size_t poolSize = ni.folded.size();
+    for (std::size_t at = 0; !key.empty() && at < poolSize; )
+    {
+        const void* hit = memmem(pool + at, poolSize - at, key.data(), key.size());
+        if (!hit) break;
+        std::size_t offset = static_cast<const char*>(hit) - pool;
+        int row = int(std::upper_bound(ni.starts.begin(), ni.starts.end(), offset) - ni.starts.begin()) - 1;
+        rows.push_back(row);
+        at = row + 1 < int(ni.starts.size()) ? ni.starts[row + 1] : poolSize; //one hit per name
+    }
+    if (key.empty())
+    {
+        rows.resize(gb.studentCount);
+        for (int i=0; i<gb.studentCount; i++) rows[i] = i;
+    }
+    matches = int(rows.size());
+    std::size_t shown = std::min(rows.size(), std::size_t(limit));
+    std::partial_sort(rows.begin(), rows.begin() + shown, rows.end(), before);
+    rows.resize(shown);
+    return rows;
+}
+
+// ---------------- rank index ----------------
+// A student's place in the ranking (average highest first, id breaking ties,
+// the same order as rankStudents) without sorting the class. The rows form a
+// treap ordered by that key; every node keeps its subtree size, so the rank of
+// a row and the row at a rank are one walk from the root, O(log n) expected.
+// appendStudent inserts the new row and setMark takes a row out and puts it
+// back under its new average. A student with no graded test is not in the
+// treap and has no rank. Priorities are a hash of the row, so the tree has
+// the same shape on every run. The index is built the first time a rank is
+// asked for; only the writer's thread uses it.
+
+std::uint32_t rankPriority(int row)
+{
+    std::uint32_t h = std::uint32_t(row) * 0x9E3779B1u;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+// True when row a ranks ahead of row b, by the averages they are filed under.
+bool rankBefore(const Gradebook &gb, int a, int b)
+{
+    double va = gb.rank.nodes[a].avg, vb = gb.rank.nodes[b].avg;
+    if (va != vb) return va > vb;
+    return compareIds(gb, a, gb, b) < 0;
+}
+
+int rankSize(const RankIndex &r, int t)
+{
+    return t < 0 ? 0 : r.nodes[t].size;
+}
+
+void rankPull(RankIndex &r, int t)
+{
+    r.nodes[t].size = 1 + rankSize(r, r.nodes[t].left) + rankSize(r, r.nodes[t].right);
+}
+
+// Splits subtree t into the rows ranked ahead of row (a) and the rest (b).
+void rankSplit(const Gradebook &gb, RankIndex &r, int t, int row, int &a, int &b)
+{
+    if (t < 0)
+    {
+        a = b = -1;
+        return;
+    }
+    if (rankBefore(gb, t, row))
+    {
+        rankSplit(gb, r, r.nodes[t].right, row, r.nodes[t].right, b);
+        a = t;
+    }
+    else
+    {
+        rankSplit(gb, r, r.nodes[t].left, row, a, r.nodes[t].left);
+        b = t;
+    }
+    rankPull(r, t);
+}
+
+// Joins two subtrees where every row of a ranks ahead of every row of b.
+int rankMerge(RankIndex &r, int a, int b)
+{
+    if (a < 0) return b;
+    if (b < 0) return a;
+    if (rankPriority(a) > rankPriority(b))
+    {
+        r.nodes[a].right = rankMerge(r, r.nodes[a].right, b);
+        rankPull(r, a);
+        return a;
+    }
+    r.nodes[b].left = rankMerge(r, a, r.nodes[b].left);
+    rankPull(r, b);
+    return b;
+}
+
+int rankEraseFirst(RankIndex &r, int t)
+{
+    if (r.nodes[t].left < 0) return r.nodes[t].right;
+    r.nodes[t].left = rankEraseFirst(r, r.nodes[t].left);
+    rankPull(r, t);
+    return t;
+}
+
+void rankInsert(Gradebook &gb, int row)
+{
+    RankIndex &r = gb.rank;
+    if (!r.built || gb.agg.rows[row].graded == 0) return;
+    if (std::size_t(row) >= r.nodes.size()) r.nodes.resize(row + 1);
+    r.nodes[row] = RankNode{-1, -1, 1, rowAverage(gb.agg.rows[row])};
+    int a, b;
+    rankSplit(gb, r, r.root, row, a, b);
+    r.root = rankMerge(r, rankMerge(r, a, row), b);
+}
+
+void rankErase(Gradebook &gb, int row)
+{
+    RankIndex &r = gb.rank;
+    if (!r.built || gb.agg.rows[row].graded == 0) return;
+    int a, b;
+    rankSplit(gb, r, r.root, row, a, b);
+    r.root = rankMerge(r, a, rankEraseFirst(r, b)); //row is the first of b
+}
+
+// Sorts the rows once and builds the treap from that order in O(n) with the
+// usual right-spine stack.
+void buildRankIndex(Gradebook &gb)
+{
+    RankIndex &r = gb.rank;
+    int n = gb.studentCount;
+    r.nodes.assign(n, RankNode{-1, -1, 1, 0});
+    std::vector<int> order;
+    order.reserve(n);
+    for (int i=0; i<n; i++)
+    {
+        r.nodes[i].avg = rowAverage(gb.agg.rows[i]);
+        if (gb.agg.rows[i].graded > 0) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&gb](int a, int b) { return rankBefore(gb, a, b); });
+    std::vector<int> spine;
+    for (int row : order)
+    {
+        int last = -1;
+        while (!spine.empty() && rankPriority(spine.back()) < rankPriority(row))
+        {
+            last = spine.back();
+            spine.pop_back();
+            rankPull(r, last);
+        }
+        r.nodes[row].left = last;
+        if (!spine.empty()) r.nodes[spine.back()].right = row;
+        spine.push_back(row);
+    }
+    r.root = spine.empty() ? -1 : spine[0];
+    for (int i=int(spine.size())-1; i>=0; i--) rankPull(r, spine[i]);
+    r.built = true;
+}
+
+//Students in the ranking: those with at least one graded test.
+int rankedStudents(const Gradebook &gb)
+{
+    return gb.studentCount - gb.agg.ungraded;
+}
+
+// 1-based position of row in the ranking, -1 for a student with no graded test.
+int studentRank(Gradebook &gb, int row)
+{
+    if (gb.agg.rows[row].graded == 0) return -1;
+    if (!gb.rank.built) buildRankIndex(gb);
+    const RankIndex &r = gb.rank;
+    int ahead = 0;
+    for (int t=r.root; t>=0; )
+    {
+        if (t == row) return ahead + rankSize(r, r.nodes[t].left) + 1;
+        if (rankBefore(gb, t, row))
+        {
+            ahead += rankSize(r, r.nodes[t].left) + 1;
+            t = r.nodes[t].right;
+        }
+        else t = r.nodes[t].left;
+    }
+    return -1;
+}
+
+// The row at a 1-based rank.
+int rowAtRank(Gradebook &gb, int rank)
+{
+    if (!gb.rank.built) buildRankIndex(gb);
+    const RankIndex &r = gb.rank;
+    int t = r.root;
+    while (t >= 0)
+    {
+        int leftSize = rankSize(r, r.nodes[t].left);
+        if (rank <= leftSize) t = r.nodes[t].left;
+        else if (rank == leftSize + 1) return t;
+        else
+        {
+            rank -= leftSize + 1;
+            t = r.nodes[t].right;
+        }
+    }
+    return -1;
+}
+
+// Share of the class ranked below the student at rank, in percent.
+double rankPercentile(int rank, int students)
+{
+    return students > 0 ? 100.0 * (students - rank) / students : 0.0;
+}
+
+// Appends one row to every column and registers the id. The caller has
+// already validated the id and checked it is not a duplicate.
+int appendStudent(Gradebook &gb, const char* id, const char* name, const Mark* row)
+{
+    reserveStudents(gb, gb.studentCount + 1);
+    int idx = gb.studentCount;
+
+    std::size_t idLen = std::strlen(id);
+    if (idLen > ID_LEN - 1) idLen = ID_LEN - 1;
+    std::vector<char> &ids = gb.ids.own();
+    ids.insert(ids.end(), id, id + idLen);
+    ids.insert(ids.end(), ID_LEN - idLen, '\0');
+    gb.idKeys.own().push_back(packId(ids.data() + std::size_t(idx) * ID_LEN));
+
+    std::vector<char> &pool = gb.namePool.own();
+    std::size_t nameBytes = std::strlen(name) + 1;
+    if (gb.shared && pool.size() + nameBytes > pool.capacity())
+    {
+        reserveColumn(gb, pool, std::max(pool.size() + nameBytes, pool.capacity() * 2));
+        publishView(gb);
+    }
+    gb.nameOffsets.own().push_back(static_cast<std::uint32_t>(pool.size()));
+    pool.insert(pool.end(), name, name + nameBytes);
+
+    std::vector<Mark> &marks = gb.marks.own();
+    marks.insert(marks.end(), row, row + gb.testCount);
+
+    if (gb.agg.totalCounts.empty()) rebuildAggregates(gb);
+    gb.agg.rows.push_back(rowAggregate(row, gb.testCount));
+    if (gb.shared) seqBegin(gb.shared->classSeq);
+    countTotal(gb.agg, gb.testCount, gb.agg.rows.back());
+    countMarks(gb.agg, row, gb.testCount, 1);
+
+    ++gb.studentCount;
+    if (gb.shared)
+    {
+        gb.shared->visible.store(gb.studentCount, std::memory_order_release);
+        seqEnd(gb.shared->classSeq);
+    }
+    gb.testColumnsStale = true;
+    idIndexInsert(gb.index, gb, idx);
+    rankInsert(gb, idx);
+    nameIndexAdd(gb, idx, name);
+    if (gb.journal) journalAdd(*gb.journal, id, name, row, gb.testCount);
+    return idx;
+}
+
+// The one place a mark changes after a student is added.
+void setMark(Gradebook &gb, int row, int test, int value)
+{
+    rankErase(gb, row);
+    SharedReads* shared = gb.shared.get();
+    if (shared)
+    {
+        seqBegin(shared->rowSeq.get()[row]);
+        seqBegin(shared->classSeq);
+    }
+    Mark* marks = studentRow(gb, row);
+    Mark stored = marks[test];
+    int old = markValue(stored);
+    marks[test] = Mark(value);
+
+    RowAggregate &ra = gb.agg.rows[row];
+    uncountTotal(gb.agg, gb.testCount, ra);
+    if (stored > 100) ra = rowAggregate(marks, gb.testCount); //the test's first mark
+    else
+    {
+        ra.total += value - old;
+        if (value <= ra.low) ra.low = value;
+        else if (old == ra.low) ra.low = minScore(marks, gb.testCount);
+        if (value >= ra.high) ra.high = value;
+        else if (old == ra.high) ra.high = maxScore(marks, gb.testCount);
+        --gb.agg.markCounts[markBucket(test, stored)];
+    }
+    countTotal(gb.agg, gb.testCount, ra);
+    ++gb.agg.markCounts[markBucket(test, Mark(value))];
+    if (!gb.testColumnsStale) gb.testColumns[std::size_t(test) * gb.studentCount + row] = std::uint8_t(value);
+    if (shared)
+    {
+        seqEnd(shared->classSeq);
+        seqEnd(shared->rowSeq.get()[row]);
+    }
+    rankInsert(gb, row);
+
+    if (gb.journal) journalSet(*gb.journal, studentId(gb, row), test, value);
+}
+
+// Lets other threads read the class from now on, see "concurrent readers".
+// Borrowed snapshot columns are copied first, so later writes never move them.
+void enableSharedReads(Gradebook &gb)
+{
+    if (gb.shared) return;
+    if (gb.agg.totalCounts.empty()) rebuildAggregates(gb);
+    gb.ids.own();
+    gb.nameOffsets.own();
+    gb.namePool.own();
+    gb.marks.own();
+    gb.index.slots.own();
+    if (gb.index.slots.empty()) gb.index.slots.own().assign(64, 0);
+    gb.shared = std::make_shared<SharedReads>();
+    reserveRowSeq(*gb.shared, 0, std::max(gb.capacity, 1));
+    gb.shared->visible.store(gb.studentCount);
+    publishView(gb);
+}
+
+// ---------------- buffered report output ----------------
+// Big tables are formatted straight into one reusable buffer and handed to
+// cout a megabyte at a time, instead of a stream insertion (and its setw /
+// fixed / setprecision state changes) per cell. Cells are padded exactly like
+// setw with left or right, and cellFixed2 prints what fixed+setprecision(2)
+// prints, so the output is byte for byte what the stream version produced.
+
+struct TableColumn
+{
+    int width;
+    bool left;
+};
+
+const TableColumn LIST_COLUMNS[4] = {{15, true}, {20, true}, {10, false}, {8, false}};
+const TableColumn RANKING_COLUMNS[5] = {{5, true}, {14, true}, {20, true}, {10, false}, {8, false}};
+
+// v with two decimals, as printf("%.2f") rounds it. The fast path does the
+// rounding in integer cents; values within a hair of a half cent (where the
+// exact binary value decides) and anything out of range go to snprintf.
+int formatFixed2(double v, char* out, int size)
+{
+    if (!(v >= 0 && v < 1e9)) return std::snprintf(out, size, "%.2f", v);
+    double scaled = v * 100.0;
+    double whole = std::floor(scaled);
+    double frac = scaled - whole;
+    if (std::fabs(frac - 0.5) < 1e-6) return std::snprintf(out, size, "%.2f", v);
+    long long cents = static_cast<long long>(whole) + (frac > 0.5 ? 1 : 0);
+    char* p = std::to_chars(out, out + size, cents / 100).ptr;
+    *p++ = '.';
+    *p++ = char('0' + cents % 100 / 10);
+    *p++ = char('0' + cents % 10);
+    return int(p - out);
+}
+
+void appendFixed2(std::string &out, double v)
+{
+    char tmp[400];
+    out.append(tmp, formatFixed2(v, tmp, sizeof(tmp)));
+}
+
+//An average, or "-" for NO_AVERAGE.
+void appendAverage(std::string &out, double avg)
+{
+    if (avg < 0) out += '-';
+    else appendFixed2(out, avg);
+}
+
+std::string averageText(double avg)
+{
+    std::string text;
+    appendAverage(text, avg);
+    return text;
+}
+
+void appendInt(std::string &out, long long v)
+{
+    char tmp[24];
+    out.append(tmp, std::to_chars(tmp, tmp + sizeof(tmp), v).ptr - tmp);
+}
+
+struct ReportWriter
+{
+    std::vector<char> buf;
+    std::size_t used = 0;
+    std::string* into = nullptr; //flush appends here instead of writing to cout
+
+    ReportWriter() : buf(1 << 20) {}
+    explicit ReportWriter(std::string &out) : buf(1 << 16), into(&out) {}
+    ~ReportWriter() { flush(); }
+
+    char* room(std::size_t len)
+    {
+        if (used + len > buf.size())
+        {
+            flush();
+            if (len > buf.size()) buf.resize(len);
+        }
+        char* p = buf.data() + used;
+        used += len;
+        return p;
+    }
+
+    void text(const char* s, std::size_t len) { std::memcpy(room(len), s, len); }
+    void text(const char* s) { text(s, std::strlen(s)); }
+    void repeat(char c, std::size_t n) { std::memset(room(n), c, n); }
+
+    void cell(const char* s, std::size_t len, const TableColumn &col)
+    {
+        std::size_t pad = len < std::size_t(col.width) ? col.width - len : 0;
+        char* p = room(len + pad);
+        if (!col.left) { std::memset(p, ' ', pad); p += pad; }
+        std::memcpy(p, s, len);
+        if (col.left) std::memset(p + len, ' ', pad);
+    }
+    void cell(const char* s, const TableColumn &col) { cell(s, std::strlen(s), col); }
+    void cell(std::string_view s, const TableColumn &col) { cell(s.data(), s.size(), col); }
+
+    void cellInt(long long v, const TableColumn &col)
+    {
+        char tmp[24];
+        cell(tmp, std::to_chars(tmp, tmp + sizeof(tmp), v).ptr - tmp, col);
+    }
+
+    void cellFixed2(double v, const TableColumn &col)
+    {
+        char tmp[400];
+        cell(tmp, formatFixed2(v, tmp, sizeof(tmp)), col);
+    }
+
+    void cellAverage(double avg, const TableColumn &col)
+    {
+        if (avg < 0) cell("-", 1, col);
+        else cellFixed2(avg, col);
+    }
+
+    void flush()
+    {
+        if (used > 0 && into) into->append(buf.data(), used);
+        else if (used > 0) cout.write(buf.data(), used);
+        used = 0;
+    }
+};
+
+// The setw/fixed version of a table left cout in this state; later plain
+// cout<< output (e.g. marks in a report) depends on it, so keep it that way.
+void restoreTableStreamState()
+{
+    cout<<std::right<<std::fixed<<std::setprecision(2);
+}
+
+void printStudentReport(Gradebook &gb)
+{
+    int testCount = gb.testCount;
+    char id[ID_LEN];
+    readId("Enter Student ID: ", id, ID_LEN);
+    if (inputAborted()) return;
+    ReadGuard guard(gb.shared.get());
+    int idx = findStudentById(gb, id);
+    if (idx == -1)
+    {
+        commandError() << "Student not found!\n";
+        return;
+    }
+    std::vector<Mark> row(testCount); //add marks..
+    RowAggregate ra;
+    readStudent(gb, idx, row.data(), ra);
+    double total = ra.total;
+    double avg = rowAverage(ra);
+
+    cout<< "\n--- Student Report ---\n\n";
+    cout<<"ID:           "<<id <<"\n";
+    cout<<"Name:         "<<studentName(gb, idx) <<"\n";
+    cout<<"Marks:        "; for (int i=0; i < testCount; i++) {printMark(row[i]); cout<<(i+1==testCount ? "" : ", "); }cout<<'\n';
+    cout<<"Total:        "<<std::fixed<<std::setprecision(2)<<total <<"\n";
+    if (ra.graded == 0)
+    {
+        cout<<"Minimum Mark: -\nHighest Mark: -\nAverage:      -\nRank:         -\nPercentile:   -\n";
+        cout<<"Grade:        -    \nStatus:       -\n\n";
+        return;
+    }
+    cout<<"Minimum Mark: "<<ra.low <<"\n";
+    cout<<"Highest Mark: "<<ra.high <<"\n";
+    cout<<"Average:      "<<std::fixed<<std::setprecision(2)<<avg <<"\n";
+    int rank = studentRank(gb, idx);
+    int ranked = rankedStudents(gb);
+    cout<<"Rank:         "<<rank<<" of "<<ranked<<"\n";
+    cout<<"Percentile:   "<<rankPercentile(rank, ranked)<<"\n";
+    cout<<"Grade:        "<<std::left<<std::setw(5)<<letterGrade(avg) <<"\n";
+    cout<<"Status:       "; cout<<passStatus(avg)<<"\n\n";
+}
+
+// The student list table for count rows, taken from rows (all rows in order
+// when rows is null).
+void printStudentList(const Gradebook &gb, const int* rows, int count)
+{
+    ReportWriter out;
+    out.text("\n-------------------- Student List -------------------\n\n");
+    out.cell("ID", LIST_COLUMNS[0]);
+    out.cell("Name", LIST_COLUMNS[1]);
+    out.cell("Average", LIST_COLUMNS[2]);
+    out.cell("Grade", LIST_COLUMNS[3]);
+    out.text("\n");
+    out.repeat('-', 15+10+20+8);
+    out.text("\n");
+
+    for (int k=0; k<count; k++)
+    {
+        int i = rows ? rows[k] : k;
+        double avg = rowAverage(readAggregate(gb, i));
+        out.cell(studentId(gb, i), LIST_COLUMNS[0]);
+        out.cell(studentName(gb, i), LIST_COLUMNS[1]);
+        out.cellAverage(avg, LIST_COLUMNS[2]);
+        out.cell(letterGrade(avg), LIST_COLUMNS[3]);
+        out.text("\n");
+    }
+    out.text("\n");
+    out.flush();
+    restoreTableStreamState();
+}
+
+// Every student, in the order they were added or (byId) in id order.
+void listStudents(const Gradebook &gb, bool byId)
+{
+    ReadGuard guard(gb.shared.get());
+    int studentCount = visibleStudents(gb);
+    if (studentCount==0) 
+    {
+        cout<<"No students yet.\n";
+        return;
+    }
+    std::vector<int> order;
+    if (byId) order = idOrder(gb, studentCount);
+    printStudentList(gb, byId ? order.data() : nullptr, studentCount);
+}
+
+// Menu: the students whose name starts with or contains what is typed.
+void findByName(Gradebook &gb)
+{
+    using Clock = std::chrono::steady_clock;
+    if (gb.studentCount==0)
+    {
+        cout<<"No Students yet.\n";
+        return;
+    }
+    int mode = readIntRange("1) Names starting with  2) Names containing: ", 1, 2);
+    if (inputAborted()) return;
+    char text[NAME_LEN];
+    readName("Part of the name (any case): ", text, NAME_LEN, 1);
+    if (inputAborted()) return;
+    int limit = readIntRange("Show at most how many: ", 1, INT_MAX); //searchNames stops at the number of matches
+    if (inputAborted()) return;
+
+    auto t0 = Clock::now();
+    int matches = 0;
+    std::vector<int> rows = searchNames(gb, text, mode == 2, limit, matches);
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+    cout<<"Showing "<<rows.size()<<" of "<<matches<<" matching students ("<<std::fixed<<std::setprecision(2)<<us<<" us).\n";
+    if (!rows.empty()) printStudentList(gb, rows.data(), int(rows.size()));
+}
+
+void addStudent(Gradebook &gb)
+{
+    int testCount = gb.testCount;
+    char id[ID_LEN]{};
+    char name[NAME_LEN]{};
+
+    readId("Enter a New Student ID: ", id, ID_LEN );
+    if (inputAborted()) return;
+    if (findStudentById(gb, id) > -1) 
+    {
+        commandError()<<"Student id alread exists!\n";
+        return ;
+    } 
+    readName("Enter a Student Name: ", name, NAME_LEN, testCount);
+
+    if (!batchInput) cout << "Enter the scores for " << testCount << " assessment(s) (0 to 100).\n";
+    std::vector<Mark> row(testCount);
+    for (int i=0; i<testCount; i++){
+        row[i] = Mark(readIntRange("mark: ", 0, 100)); //readIntRange(std::string prompt, int minV, int maxV)
+    }
+    if (inputAborted()) return;
+    appendStudent(gb, id, name, row.data());
+    cout<<"Student added.\n";
+}
+
+void updateMarks(Gradebook &gb)
+{
+    int testCount = gb.testCount;
+    char id[ID_LEN];
+    readId("Enter Student ID: ", id, ID_LEN);
+    if (inputAborted()) return;
+    int idx = findStudentById(gb, id);
+    if (idx<0){
+        commandError()<<"Student not found!\n";
+        return;
+    }
+    if (!batchInput)
+    {
+        cout << "Updating assessment score(s) for " << studentName(gb, idx) << " (" << studentId(gb, idx) << ").\n";
+
+        const Mark* row = studentRow(gb, idx);
+        cout << "Select the assessment to update:\n";
+        for (int i=0; i<testCount; i++)
+        {
+            cout << " " << (i + 1) << ") Current score: ";
+            printMark(row[i]);
+            cout << "\n";
+        }
+    }
+    int testNo = readIntRange("", 1, testCount);
+    int newValue = readIntRange("New Value: ", 0, 100);
+    if (inputAborted()) return;
+
+    setMark(gb, idx, testNo-1, newValue);
+    cout<<"Updated.\n";
+}
+
+// ---------------- ranking engine ----------------
+// Every average is computed once, then the rows are ordered by average
+// (highest first) with the student id breaking ties, so the order is total
+// and the same on every run. Large classes are ranked on the thread pool.
+
+struct RankEntry
+{
+    double avg;
+    int row;
+};
+
+// True when a ranks ahead of b.
+bool ranksAhead(const Gradebook &gb, const RankEntry &a, const RankEntry &b)
+{
+    if (a.avg != b.avg) return a.avg > b.avg;
+    return compareIds(gb, a.row, gb, b.row) < 0;
+}
+
+//The students with a graded test and their averages, in row order.
+std::vector<RankEntry> rankEntries(const Gradebook &gb)
+{
+    int n = visibleStudents(gb);
+    std::vector<RankEntry> entries(n);
+    int parts = parallelParts(gb, n);
+    std::vector<int> bounds = splitRows(n, parts);
+    auto fill = [&](int t)
+    {
+        ReadGuard guard(gb.shared.get()); //pool threads read too
+        for (int i=bounds[t]; i<bounds[t + 1]; i++) entries[i] = {rowAverage(readAggregate(gb, i)), i};
+    };
+    if (parts == 1) fill(0);
+    else gb.pool->run(parts, fill);
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const RankEntry &e) { return e.avg < 0; }), entries.end());
+    return entries;
+}
+
+// Full ranking, best first. O(n log n); chunks are sorted in parallel and then
+// merged pairwise, also in parallel.
+std::vector<RankEntry> rankStudents(const Gradebook &gb)
+{
+    OpTimer timer(STAT_RANK_SORT);
+    std::vector<RankEntry> entries = rankEntries(gb);
+    auto ahead = [&gb](const RankEntry &a, const RankEntry &b) { return ranksAhead(gb, a, b); };
+    int n = static_cast<int>(entries.size());
+    int parts = parallelParts(gb, n);
+    if (parts == 1)
+    {
+        std::sort(entries.begin(), entries.end(), ahead);
+        return entries;
+    }
+    std::vector<int> bounds = splitRows(n, parts);
+    gb.pool->run(parts, [&](int t)
+    {
+        ReadGuard guard(gb.shared.get());
+        std::sort(entries.begin() + bounds[t], entries.begin() + bounds[t + 1], ahead);
+    });
+    for (int width=1; width<parts; width*=2)
+    {
+        gb.pool->run(parts / (2 * width), [&](int t)
+        {
+            ReadGuard guard(gb.shared.get());
+            int lo = bounds[2 * width * t], mid = bounds[2 * width * t + width], hi = bounds[2 * width * (t + 1)];
+            std::inplace_merge(entries.begin() + lo, entries.begin() + mid, entries.begin() + hi, ahead);
+        });
+    }
+    return entries;
+}
+
+// The k best (or worst) students without sorting the whole class: each chunk
+// keeps its own k candidates, and the survivors are ordered at the end.
+// Worst-first order is used when best is false. If ranked is given it is set
+// to how many students that same read ranked, which the bottom ranks count from.
+std::vector<RankEntry> topStudents(const Gradebook &gb, int k, bool best, int* ranked = nullptr)
+{
+    OpTimer timer(STAT_TOP_K);
+    std::vector<RankEntry> entries = rankEntries(gb);
+    if (ranked) *ranked = static_cast<int>(entries.size());
+    auto order = [&gb, best](const RankEntry &a, const RankEntry &b)
+    {
+        return best ? ranksAhead(gb, a, b) : ranksAhead(gb, b, a);
+    };
+    int n = static_cast<int>(entries.size());
+    if (k > n) k = n;
+    int parts = parallelParts(gb, n);
+    if (parts > 1)
+    {
+        std::vector<int> bounds = splitRows(n, parts);
+        std::vector<int> kept(parts);
+        gb.pool->run(parts, [&](int t)
+        {
+            ReadGuard guard(gb.shared.get());
+            auto first = entries.begin() + bounds[t], last = entries.begin() + bounds[t + 1];
+            int keep = std::min<int>(k, static_cast<int>(last - first));
+            std::nth_element(first, first + keep, last, order);
+            kept[t] = keep;
+        });
+        int out = 0;
+        for (int t=0; t<parts; t++)
+        {
+            std::copy(entries.begin() + bounds[t], entries.begin() + bounds[t] + kept[t], entries.begin() + out);
+            out += kept[t];
+        }
+        entries.resize(out);
+    }
+    std::partial_sort(entries.begin(), entries.begin() + k, entries.end(), order);
+    entries.resize(k);
+    return entries;
+}
+
+void printRankingHeader(ReportWriter &out)
+{
+    out.cell("#", RANKING_COLUMNS[0]);
+    out.cell("ID", RANKING_COLUMNS[1]);
+    out.cell("Name", RANKING_COLUMNS[2]);
+    out.cell("Average", RANKING_COLUMNS[3]);
+    out.cell("Grade", RANKING_COLUMNS[4]);
+    out.text("\n");
+    out.repeat('-', 5+14+20+10+8);
+    out.text("\n");
+}
+
+//A rank below 1 (a student with no graded test) prints as "-".
+void printRankingRow(ReportWriter &out, const Gradebook &gb, int rank, const RankEntry &e)
+{
+    if (rank > 0) out.cellInt(rank, RANKING_COLUMNS[0]);
+    else out.cell("-", RANKING_COLUMNS[0]);
+    out.cell(studentId(gb, e.row), RANKING_COLUMNS[1]);
+    out.cell(studentName(gb, e.row), RANKING_COLUMNS[2]);
+    out.cellAverage(e.avg, RANKING_COLUMNS[3]);
+    out.cell(letterGrade(e.avg), RANKING_COLUMNS[4]);
+    out.text("\n");
+}
+
+// ---------------- quantiles ----------------
+// Marks are whole numbers 0..100 and totals whole numbers 0..100*testCount,
+// so the histograms kept in ClassAggregates are the exact distribution: a
+// quantile is a walk over a few hundred buckets instead of a sort of the
+// class. Between two order statistics the value is interpolated by the usual
+// (n-1)*q rule, so the answer is the same as on a sorted list.
+
+const int QUANTILE_COUNT = 5;
+const double QUANTILE_POINTS[QUANTILE_COUNT] = {0.10, 0.25, 0.50, 0.75, 0.90};
+
+// Value of the 0-based rank-th smallest entry counted in counts[0..buckets).
+int histValueAt(const int* counts, int buckets, long long rank)
+{
+    long long seen = 0;
+    for (int b=0; b<buckets; b++)
+    {
+        seen += counts[b];
+        if (seen > rank) return b;
+    }
+    return buckets - 1;
+}
+
+// out[k] = quantile QUANTILE_POINTS[k] of n sorted values, valueAt(rank) giving each one.
+template <typename ValueAt>
+void rankQuantiles(long long n, ValueAt valueAt, double* out)
+{
+    for (int k=0; k<QUANTILE_COUNT; k++)
+    {
+        if (n == 0) { out[k] = 0; continue; }
+        double pos = (n - 1) * QUANTILE_POINTS[k];
+        long long lo = static_cast<long long>(pos);
+        double low = valueAt(lo);
+        double high = lo + 1 < n ? valueAt(lo + 1) : low;
+        out[k] = low + (pos - lo) * (high - low);
+    }
+}
+
+// out[k] = quantile QUANTILE_POINTS[k] of the histogram, in bucket units.
+void histQuantiles(const int* counts, int buckets, double* out)
+{
+    long long n = 0;
+    for (int b=0; b<buckets; b++) n += counts[b];
+    rankQuantiles(n, [&](long long rank) { return double(histValueAt(counts, buckets, rank)); }, out);
+}
+
+// Quantiles of the students' averages: the fully graded ones are filed by
+// total, the rest by average step, so the two histograms are walked as one.
+void averageQuantiles(const std::vector<int> &totals, const std::vector<int> &partial, int testCount, double* out)
+{
+    long long n = 0, partialN = 0;
+    for (int c : totals) n += c;
+    for (int c : partial) partialN += c;
+    if (partialN == 0)
+    {
+        histQuantiles(totals.data(), int(totals.size()), out);
+        for (int k=0; k<QUANTILE_COUNT; k++) out[k] /= testCount;
+        return;
+    }
+    auto valueAt = [&](long long rank)
+    {
+        int t = 0, p = 0;
+        int tEnd = int(totals.size()), pEnd = int(partial.size());
+        long long seen = 0;
+        double value = 0;
+        while (seen <= rank && (t < tEnd || p < pEnd))
+        {
+            //every step files the lower of the next total and the next average step
+            if (p >= pEnd || (t < tEnd && double(t) / testCount <= p / 100.0))
+            {
+                seen += totals[t];
+                value = double(t++) / testCount;
+            }
+            else
+            {
+                seen += partial[p];
+                value = p++ / 100.0;
+            }
+        }
+        return value;
+    };
+    rankQuantiles(n + partialN, valueAt, out);
+}
+
+void printQuantileRow(const char* label, const double* q)
+{
+    cout<<std::left<<std::setw(14)<<label<<std::right;
+    for (int k=0; k<QUANTILE_COUNT; k++) cout<<std::setw(9)<<q[k];
+    cout<<std::setw(9)<<q[3] - q[1]<<'\n';
+}
+
+// Median, quartiles, P10/P90 and IQR of the averages and of every assessment.
+void printQuantiles(const Gradebook &gb)
+{
+    std::vector<int> totals, partial, marks;
+    readHistograms(gb, totals, partial, marks);
+    double q[QUANTILE_COUNT];
+
+    cout<<"\n------ Distribution -------\n\n";
+    cout<<std::left<<std::setw(14)<<""<<std::right<<std::setw(9)<<"P10"<<std::setw(9)<<"Q1"<<std::setw(9)<<"Median"
+        <<std::setw(9)<<"Q3"<<std::setw(9)<<"P90"<<std::setw(9)<<"IQR"<<'\n';
+    cout<<std::fixed<<std::setprecision(2);
+    averageQuantiles(totals, partial, gb.testCount, q);
+    printQuantileRow("Average", q);
+    for (int t=0; t<gb.testCount; t++)
+    {
+        std::string label = "Assessment " + std::to_string(t + 1);
+        histQuantiles(marks.data() + std::size_t(t) * 101, 101, q);
+        printQuantileRow(label.c_str(), q);
+    }
+}
+
+void classSummaryAndRanging(const Gradebook &gb)
+{
+    ReadGuard guard(gb.shared.get());
+    // class status, straight from the running aggregates
+    ClassTotals agg = readClassTotals(gb);
+    int studentCount = agg.students;
+    if (studentCount==0){
+        cout<<"No Students yet.\n";
+        return;
+    }
+
+    std::vector<RankEntry> ranking = rankStudents(gb);
+
+    double classAvg = agg.classAvg;
+    double bestAvg = agg.bestAvg;
+    double worstAvg = agg.worstAvg;
+    int passCount = agg.passCount;
+    int graded = agg.graded;
+
+    cout<<"\n------ Class Summary -------\n\n";
+    cout<<"Number of Students : "<<studentCount<<"\n";
+    if (graded < studentCount)
+        cout<<"Not Yet Graded     : "<<studentCount - graded<<" (left out of the averages and the ranking)\n";
+    cout<<"Class Average      : "<<averageText(classAvg)<<'\n';
+    cout<<"Highest Average    : "<<averageText(bestAvg)<<'\n';
+    cout<<"Lowest Average     : "<<averageText(worstAvg)<<'\n';
+    if (graded > 0)
+        cout<<"Pass Rate          : "<<std::fixed<<std::setprecision(2) <<(double(passCount) / graded) * 100.0<<"% \n";
+    else
+        cout<<"Pass Rate          : -\n";
+    printQuantiles(gb);
+
+    OpTimer timer(STAT_RANKING_TABLE);
+    ReportWriter out;
+    out.text("\n-------- Performance Ranking (Highest to Lowest) --------\n\n");
+    printRankingHeader(out);
+    for (int rank=0; rank < int(ranking.size()); ++rank) //rows added since the totals were read rank too
+    {
+        printRankingRow(out, gb, rank+1, ranking[rank]);
+    }
+    out.text("\n");
+    out.flush();
+    restoreTableStreamState();
+}
+
+// Ranks first..last straight from the rank index, one O(log n) lookup per row.
+void showRankRange(Gradebook &gb)
+{
+    int ranked = rankedStudents(gb);
+    if (ranked == 0)
+    {
+        cout<<"No graded students yet.\n";
+        return;
+    }
+    int first = readIntRange("From rank: ", 1, ranked);
+    int last = readIntRange("To rank: ", first, ranked);
+    if (inputAborted()) return;
+
+    cout<<"\n-------- Students Ranked "<<first<<" to "<<last<<" --------\n\n";
+    ReportWriter out;
+    printRankingHeader(out);
+    for (int rank=first; rank<=last; rank++)
+    {
+        int row = rowAtRank(gb, rank);
+        printRankingRow(out, gb, rank, RankEntry{rowAverage(gb.agg.rows[row]), row});
+    }
+    out.text("\n");
+    out.flush();
+    restoreTableStreamState();
+}
+
+void showTopStudents(Gradebook &gb)
+{
+    ReadGuard guard(gb.shared.get());
+    int studentCount = visibleStudents(gb);
+    if (studentCount==0){
+        cout<<"No Students yet.\n";
+        return;
+    }
+    int choice = readIntRange("1) Top students  2) Bottom students  3) A range of ranks: ", 1, 3);
+    if (inputAborted()) return;
+    if (choice == 3)
+    {
+        showRankRange(gb);
+        return;
+    }
+    bool best = choice == 1;
+    int k = readIntRange("How many students: ", 1, studentCount);
+    if (inputAborted()) return;
+    int ranked = 0;
+    std::vector<RankEntry> picked = topStudents(gb, k, best, &ranked); //graded students only
+    int shown = static_cast<int>(picked.size());
+
+    cout << (best ? "\n-------- Top " : "\n-------- Bottom ") << shown << " Students --------\n\n";
+    ReportWriter out;
+    printRankingHeader(out);
+    for (int i=0; i<shown; i++)
+    {
+        printRankingRow(out, gb, best ? i+1 : ranked-i, picked[i]);
+    }
+    out.text("\n");
+    out.flush();
+    restoreTableStreamState();
+}
+
+// ---------------- per-assessment statistics ----------------
+// Mean, standard deviation, min and max of one test across the whole class.
+// The kernels run over a column-major byte copy of the marks (marks are whole
+// numbers 0..100), one contiguous column per test, so a vector register holds
+// 16 or 32 marks. Sums are exact: bytes are summed with SAD into 64-bit lanes,
+// squares are widened to 16 bits and summed in pairs with madd into 32-bit
+// lanes, in blocks short enough that those lanes can't overflow. An ungraded
+// mark stays MARK_UNGRADED (255) in the columns, so the kernels count it like a
+// mark and assessmentStats takes it back out using the mark histograms.
+
+struct ColumnStats
+{
+    long long sum = 0;
+    long long sumSquares = 0;
+    int low = 0;
+    int high = 0;
+    int graded = 0; //set by assessmentStats; the kernels leave it 0
+};
+
+const int SIMD_BLOCK = 1 << 14; //vector iterations per 32-bit square accumulation block, safe for 255s
+
+ColumnStats columnStatsScalar(const std::uint8_t* col, int n)
+{
+    ColumnStats st;
+    st.low = INT_MAX;
+    st.high = INT_MIN;
+    for (int i=0; i<n; i++)
+    {
+        int v = col[i];
+        st.sum += v;
+        st.sumSquares += v * v;
+        st.low = std::min(st.low, v);
+        st.high = std::max(st.high, v);
+    }
+    return st;
+}
+
+#ifdef GB_X86_SIMD
+__attribute__((target("sse4.1")))
+ColumnStats columnStatsSse(const std::uint8_t* col, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_set1_epi8(char(0xff)), hi = zero;
+    __m128i sum = zero, sq = zero;
+    int i = 0;
+    int vecEnd = n & ~15;
+    while (i < vecEnd)
+    {
+        int blockEnd = std::min(vecEnd, i + 16 * SIMD_BLOCK);
+        __m128i q = zero;
+        for (; i < blockEnd; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(col + i));
+            lo = _mm_min_epu8(lo, v);
+            hi = _mm_max_epu8(hi, v);
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(v, zero));
+            __m128i a = _mm_cvtepu8_epi16(v);
+            __m128i b = _mm_cvtepu8_epi16(_mm_srli_si128(v, 8));
+            q = _mm_add_epi32(q, _mm_add_epi32(_mm_madd_epi16(a, a), _mm_madd_epi16(b, b)));
+        }
+        sq = _mm_add_epi64(sq, _mm_add_epi64(_mm_cvtepu32_epi64(q), _mm_cvtepu32_epi64(_mm_srli_si128(q, 8))));
+    }
+    ColumnStats st = columnStatsScalar(col + i, n - i);
+    alignas(16) std::uint8_t bytes[16];
+    alignas(16) long long wide[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(bytes), lo);
+    if (vecEnd > 0) for (int v : bytes) st.low = std::min(st.low, v);
+    _mm_store_si128(reinterpret_cast<__m128i*>(bytes), hi);
+    if (vecEnd > 0) for (int v : bytes) st.high = std::max(st.high, v);
+    _mm_store_si128(reinterpret_cast<__m128i*>(wide), sum);
+    st.sum += wide[0] + wide[1];
+    _mm_store_si128(reinterpret_cast<__m128i*>(wide), sq);
+    st.sumSquares += wide[0] + wide[1];
+    return st;
+}
+
+__attribute__((target("avx2")))
+ColumnStats columnStatsAvx2(const std::uint8_t* col, int n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_set1_epi8(char(0xff)), hi = zero;
+    __m256i sum = zero, sq = zero;
+    int i = 0;
+    int vecEnd = n & ~31;
+    while (i < vecEnd)
+    {
+        int blockEnd = std::min(vecEnd, i + 32 * SIMD_BLOCK);
+        __m256i q = zero;
+        for (; i < blockEnd; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(col + i));
+            lo = _mm256_min_epu8(lo, v);
+            hi = _mm256_max_epu8(hi, v);
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(v, zero));
+            __m256i a = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+            __m256i b = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+            q = _mm256_add_epi32(q, _mm256_add_epi32(_mm256_madd_epi16(a, a), _mm256_madd_epi16(b, b)));
+        }
+        sq = _mm256_add_epi64(sq, _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(q)),
+                                                   _mm256_cvtepu32_epi64(_mm256_extracti128_si256(q, 1))));
+    }
+    ColumnStats st = columnStatsScalar(col + i, n - i);
+    alignas(32) std::uint8_t bytes[32];
+    alignas(32) long long wide[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(bytes), lo);
+    if (vecEnd > 0) for (int v : bytes) st.low = std::min(st.low, v);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(bytes), hi);
+    if (vecEnd > 0) for (int v : bytes) st.high = std::max(st.high, v);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(wide), sum);
+    st.sum += wide[0] + wide[1] + wide[2] + wide[3];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(wide), sq);
+    st.sumSquares += wide[0] + wide[1] + wide[2] + wide[3];
+    return st;
+}
+#endif
+
+typedef ColumnStats (*ColumnKernel)(const std::uint8_t* col, int n);
+
+// Widest kernel this CPU runs, picked once.
+ColumnKernel columnKernel()
+{
+#ifdef GB_X86_SIMD
+    static const ColumnKernel best = __builtin_cpu_supports("avx2") ? columnStatsAvx2
+        : __builtin_cpu_supports("sse4.1") ? columnStatsSse : columnStatsScalar;
+    return best;
+#else
+    return columnStatsScalar;
+#endif
+}
+
+const char* columnKernelName()
+{
+#ifdef GB_X86_SIMD
+    if (columnKernel() == columnStatsAvx2) return "AVX2";
+    if (columnKernel() == columnStatsSse) return "SSE4.1";
+#endif
+    return "scalar";
+}
+
+// testCount columns of studentCount marks each; transposed from the row-major
+// store only when a student was added since the last call (setMark keeps it current).
+const std::vector<std::uint8_t>& testColumns(Gradebook &gb)
+{
+    if (gb.testColumnsStale)
+    {
+        std::size_t n = gb.studentCount;
+        gb.testColumns.resize(n * gb.testCount);
+        int parts = parallelParts(gb, gb.studentCount);
+        std::vector<int> bounds = splitRows(gb.studentCount, parts);
+        const Gradebook &marks = gb; //const accessor: no copy of borrowed columns
+        auto transpose = [&](int p)
+        {
+            for (std::size_t i=bounds[p]; i<std::size_t(bounds[p + 1]); i++)
+            {
+                const Mark* row = studentRow(marks, int(i));
+                for (int t=0; t<gb.testCount; t++) gb.testColumns[t * n + i] = row[t];
+            }
+        };
+        if (parts == 1) transpose(0);
+        else gb.pool->run(parts, transpose);
+        gb.testColumnsStale = false;
+    }
+    return gb.testColumns;
+}
+
+void mergeColumnStats(ColumnStats &into, const ColumnStats &part)
+{
+    into.sum += part.sum;
+    into.sumSquares += part.sumSquares;
+    into.low = std::min(into.low, part.low);
+    into.high = std::max(into.high, part.high);
+}
+
+// One ColumnStats per test; the class must not be empty. Big columns are
+// cut into row ranges that run as separate pool tasks and merge in order.
+std::vector<ColumnStats> assessmentStats(Gradebook &gb)
+{
+    OpTimer timer(STAT_COLUMN_STATS);
+    const std::vector<std::uint8_t> &cols = testColumns(gb);
+    ColumnKernel kernel = columnKernel();
+    int parts = parallelParts(gb, gb.studentCount);
+    std::vector<int> bounds = splitRows(gb.studentCount, parts);
+    std::vector<ColumnStats> partial(std::size_t(parts) * gb.testCount);
+    auto scan = [&](int task)
+    {
+        int t = task / parts, p = task % parts;
+        const std::uint8_t* col = cols.data() + std::size_t(t) * gb.studentCount;
+        partial[task] = kernel(col + bounds[p], bounds[p + 1] - bounds[p]);
+    };
+    if (parts == 1) for (int t=0; t<gb.testCount; t++) scan(t);
+    else gb.pool->run(parts * gb.testCount, scan);
+
+    std::vector<ColumnStats> stats(gb.testCount);
+    for (int t=0; t<gb.testCount; t++)
+    {
+        stats[t] = partial[std::size_t(t) * parts];
+        for (int p=1; p<parts; p++) mergeColumnStats(stats[t], partial[std::size_t(t) * parts + p]);
+        //the histogram counts graded marks only; the rest of the column is 255s
+        const int* counts = gb.agg.markCounts.data() + markBucket(t, 0);
+        int graded = 0, top = -1;
+        for (int m=0; m<=100; m++) if (counts[m] > 0) { graded += counts[m]; top = m; }
+        long long ungraded = gb.studentCount - graded;
+        stats[t].graded = graded;
+        if (ungraded == 0) continue;
+        stats[t].sum -= ungraded * MARK_UNGRADED;
+        stats[t].sumSquares -= ungraded * MARK_UNGRADED * MARK_UNGRADED;
+        stats[t].high = std::max(top, 0);
+        if (graded == 0) stats[t].low = 0;
+    }
+    return stats;
+}
+
+double columnMean(const ColumnStats &st)
+{
+    return st.graded > 0 ? double(st.sum) / st.graded : 0.0;
+}
+
+// Population standard deviation of the graded marks, from the exact integer sums.
+double columnStdDev(const ColumnStats &st)
+{
+    int n = st.graded;
+    if (n == 0) return 0.0;
+    long double spread = (long double)n * st.sumSquares - (long double)st.sum * st.sum;
+    return spread > 0 ? double(std::sqrt(spread) / n) : 0.0;
+}
+
+void showAssessmentStats(Gradebook &gb)
+{
+    if (gb.studentCount==0){
+        cout<<"No Students yet.\n";
+        return;
+    }
+    std::vector<ColumnStats> stats = assessmentStats(gb);
+
+    cout<<"\n-------- Per-Assessment Statistics --------\n\n";
+    cout<<std::left<<std::setw(8)<<"Test"
+        <<std::right<<std::setw(10)<<"Mean"
+        <<std::setw(10)<<"Std Dev"
+        <<std::setw(8)<<"Min"
+        <<std::setw(8)<<"Max"
+        <<"\n";
+    cout<<std::string(44,'-')<<"\n";
+    for (int t=0; t<gb.testCount; t++)
+    {
+        cout<<std::left<<std::setw(8)<<t+1
+            <<std::right<<std::setw(10)<<std::fixed<<std::setprecision(2)<<columnMean(stats[t])
+            <<std::setw(10)<<columnStdDev(stats[t])
+            <<std::setw(8)<<stats[t].low
+            <<std::setw(8)<<stats[t].high
+            <<"\n";
+    }
+    cout<<'\n';
+}
+
+// ---------------- filter queries ----------------
+// A filter is a list of terms that must all hold, joined by "and" or commas:
+//   avg >= 45 and avg <= 50
+//   fail, t3 > 80
+//   grade = B and id = ets01*
+// parseQuery compiles every term into a range over one column. avg, grade,
+// pass and fail are ranges of the average in hundredths (averageStep, which
+// is what the tables print and the grades are cut on; a student with no
+// graded test matches none of them, negated or not), tN is a range of test
+// column N, and an id prefix is a range of packed id keys. runQuery then scans
+// QUERY_BLOCK rows at a time: each term ands one byte per row with a branch
+// free compare over a contiguous column, so the loops vectorize, and the rows
+// that survive every term come out in row order.
+
+const int QUERY_AVG = -1;     //QueryTerm::column of the average
+const int QUERY_BLOCK = 4096; //rows per scan block
+const int QUERY_LEN = 256;    //longest filter the menu reads
+
+struct QueryTerm
+{
+    int column; //QUERY_AVG or a test
+    int lo, hi; //the value must be inside [lo, hi], or outside it when negate is set
+    bool negate;
+};
+
+struct IdPrefix
+{
+    std::string text;
+    bool exact;           //id = text rather than id = text*
+    bool packs;           //some packed key can match
+    std::uint64_t lo, hi; //range of those keys
+};
+
+struct Query
+{
+    std::vector<QueryTerm> terms;
+    std::vector<IdPrefix> ids;
+    bool none = false; //a term no value can meet
+};
+
+// Packed keys that start with prefix (or equal it, when exact).
+IdPrefix compileIdPrefix(const std::string &text, bool exact)
+{
+    IdPrefix p{text, exact, false, 0, 0};
+    if (!exact && text.size() <= 3 && std::strncmp("ets", text.c_str(), text.size()) == 0)
+    {
+        p.packs = true;
+        p.hi = ID_KEY_FALLBACK - 1;
+        return p;
+    }
+    std::uint64_t key = packId(text.c_str());
+    if (key & ID_KEY_FALLBACK || text.size() <= 3) return p;
+    std::uint64_t span = 1;
+    for (std::size_t i=text.size() - 3; !exact && i<std::size_t(ID_KEY_DIGITS); i++) span *= 37;
+    p.packs = true;
+    p.lo = key;
+    p.hi = key + span - 1;
+    return p;
+}
+
+bool idMatches(const char* id, const IdPrefix &p)
+{
+    return p.exact ? p.text == id : std::strncmp(id, p.text.c_str(), p.text.size()) == 0;
+}
+
+// The integers v in [minV, maxV] with "v op x" as a range; != gives the range
+// of = and sets negate.
+void compileComparison(const std::string &op, double x, int minV, int maxV, QueryTerm &t)
+{
+    x = std::min(std::max(x, double(minV) - 1), double(maxV) + 1);
+    t.lo = minV;
+    t.hi = maxV;
+    t.negate = op == "!=";
+    if (op == "<") t.hi = int(std::ceil(x)) - 1;
+    else if (op == "<=") t.hi = int(std::floor(x));
+    else if (op == ">") t.lo = int(std::floor(x)) + 1;
+    else if (op == ">=") t.lo = int(std::ceil(x));
+    else
+    {
+        t.lo = int(std::ceil(x));
+        t.hi = int(std::floor(x));
+    }
+    t.lo = std::max(t.lo, minV);
+    t.hi = std::min(t.hi, maxV);
+}
+
+// Steps of the average that get the grade at band b.
+void gradeSteps(int band, int &lo, int &hi)
+{
+    const GradingScheme &s = *gradingScheme;
+    lo = GRADE_STEPS;
+    hi = -1;
+    for (int c=0; c<GRADE_STEPS; c++)
+    {
+        if (s.grade[c] != band) continue;
+        lo = std::min(lo, c);
+        hi = std::max(hi, c);
+    }
+}
+
+// Adds t, narrowing a term already on the same column when both are plain ranges.
+void addQueryTerm(Query &q, const QueryTerm &t)
+{
+    if (t.lo > t.hi)
+    {
+        if (!t.negate) q.none = true; //a negated empty range holds for everyone
+        return;
+    }
+    for (QueryTerm &have : q.terms)
+    {
+        if (have.column != t.column || have.negate || t.negate) continue;
+        have.lo = std::max(have.lo, t.lo);
+        have.hi = std::min(have.hi, t.hi);
+        if (have.lo > have.hi) q.none = true;
+        return;
+    }
+    q.terms.push_back(t);
+}
+
+// Compiles text into q for this class; false with a message in error when a
+// term cannot be read.
+bool parseQuery(const Gradebook &gb, const std::string &text, Query &q, std::string &error)
+{
+    q = Query();
+    std::size_t pos = 0, n = text.size();
+    auto lower = [](std::string w)
+    {
+        for (char &c : w) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return w;
+    };
+    auto skipSpace = [&] { while (pos < n && std::isspace(static_cast<unsigned char>(text[pos]))) pos++; };
+    auto word = [&]
+    {
+        std::size_t from = pos;
+        while (pos < n && std::isalnum(static_cast<unsigned char>(text[pos]))) pos++;
+        return lower(text.substr(from, pos - from));
+    };
+    auto value = [&]
+    {
+        skipSpace();
+        std::size_t from = pos;
+        while (pos < n && text[pos] != ',' && !std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+        return text.substr(from, pos - from);
+    };
+    while (true)
+    {
+        skipSpace();
+        while (pos < n && (text[pos] == ',' || text[pos] == '&'))
+        {
+            pos++;
+            skipSpace();
+        }
+        if (pos >= n) break;
+        std::string field = word();
+        if (field.empty())
+        {
+            error = "expected a term at \"" + text.substr(pos) + "\"";
+            return false;
+        }
+        if (field == "and") continue;
+        if (field == "pass" || field == "fail")
+        {
+            QueryTerm t{QUERY_AVG, 0, GRADE_STEPS - 1, false};
+            if (field == "pass") t.lo = gradingScheme->passCentis;
+            else t.hi = gradingScheme->passCentis - 1;
+            addQueryTerm(q, t);
+            continue;
+        }
+
+        skipSpace();
+        std::string op;
+        while (pos < n && op.size() < 2 && std::strchr("<>=!", text[pos])) op += text[pos++];
+        if (op == "==") op = "=";
+        if (op != "<" && op != "<=" && op != ">" && op != ">=" && op != "=" && op != "!=")
+        {
+            error = "expected < <= > >= = or != after " + field;
+            return false;
+        }
+        std::string v = value();
+        if (v.empty())
+        {
+            error = "expected a value after " + field + " " + op;
+            return false;
+        }
+
+        if (field == "id")
+        {
+            if (op != "=")
+            {
+                error = "id only takes = (add * for a prefix)";
+                return false;
+            }
+            bool exact = v.back() != '*';
+            if (!exact) v.pop_back();
+            q.ids.push_back(compileIdPrefix(lower(v), exact)); //ids are stored lower case
+            continue;
+        }
+        if (field == "grade")
+        {
+            const GradingScheme &s = *gradingScheme;
+            int band = -1;
+            for (int b=0; b<s.gradeCount; b++)
+                if (lower(std::string(s.labels[b])) == lower(v)) band = b;
+            if (band < 0)
+            {
+                error = "no grade \"" + v + "\" in the " + s.name + " scheme";
+                return false;
+            }
+            int lo, hi;
+            gradeSteps(band, lo, hi);
+            //grades compare by how good they are: grade >= B is B or better
+            QueryTerm t{QUERY_AVG, 0, GRADE_STEPS - 1, op == "!="};
+            if (op == ">=" || op == "=" || op == "!=") t.lo = lo;
+            if (op == "<=" || op == "=" || op == "!=") t.hi = hi;
+            if (op == ">") t.lo = hi + 1;
+            if (op == "<") t.hi = lo - 1;
+            addQueryTerm(q, t);
+            continue;
+        }
+
+        char* end = nullptr;
+        double x = std::strtod(v.c_str(), &end);
+        if (end == v.c_str() || *end != '\0' || !std::isfinite(x))
+        {
+            error = "\"" + v + "\" is not a number";
+            return false;
+        }
+        QueryTerm t{};
+        if (field == "avg" || field == "average")
+        {
+            t.column = QUERY_AVG;
+            double centis = x * 100;
+            if (std::fabs(centis - std::round(centis)) < 1e-6) centis = std::round(centis);
+            compileComparison(op, centis, 0, GRADE_STEPS - 1, t);
+        }
+        else
+        {
+            std::size_t digits = field[0] == 't' && field.compare(0, 4, "test") == 0 ? 4 : 1;
+            int test = field[0] == 't' && field.size() > digits ? std::atoi(field.c_str() + digits) : 0;
+            if (test < 1 || test > gb.testCount || field.find_first_not_of("0123456789", digits) != std::string::npos)
+            {
+                error = "unknown field \"" + field + "\" (tests are t1 to t" + std::to_string(gb.testCount) + ")";
+                return false;
+            }
+            t.column = test - 1;
+            compileComparison(op, x, 0, 100, t);
+        }
+        addQueryTerm(q, t);
+    }
+    return true;
+}
+
+// Rows that meet every term of q, in row order. Only the writer's thread may
+// call this (it reads testColumns).
+std::vector<int> runQuery(Gradebook &gb, const Query &q)
+{
+    OpTimer timer(STAT_QUERY_SCAN);
+    int n = gb.studentCount;
+    std::vector<int> hits;
+    if (q.none || n == 0) return hits;
+    bool needAvg = false, needTests = false;
+    for (const QueryTerm &t : q.terms) (t.column == QUERY_AVG ? needAvg : needTests) = true;
+    const std::uint8_t* cols = needTests ? testColumns(gb).data() : nullptr;
+    const RowAggregate* rows = gb.agg.rows.data();
+    const std::uint64_t* keys = gb.idKeys.data();
+
+    int parts = parallelParts(gb, n);
+    std::vector<int> bounds = splitRows(n, parts);
+    std::vector<std::vector<int>> found(parts);
+    auto scan = [&](int p)
+    {
+        std::uint8_t keep[QUERY_BLOCK];
+        std::uint16_t steps[QUERY_BLOCK];
+        for (int first=bounds[p]; first<bounds[p + 1]; first+=QUERY_BLOCK)
+        {
+            int len = std::min(QUERY_BLOCK, bounds[p + 1] - first);
+            std::fill(keep, keep + len, std::uint8_t(1));
+            if (needAvg)
+                for (int i=0; i<len; i++)
+                {
+                    steps[i] = std::uint16_t(averageStep(rowAverage(rows[first + i])));
+                    keep[i] = std::uint8_t(rows[first + i].graded > 0); //no average to compare
+                }
+            for (const QueryTerm &t : q.terms)
+            {
+                unsigned lo = t.lo, width = t.hi - t.lo;
+                std::uint8_t flip = t.negate;
+                if (t.column == QUERY_AVG)
+                {
+                    for (int i=0; i<len; i++) keep[i] &= std::uint8_t(unsigned(steps[i]) - lo <= width) ^ flip;
+                }
+                else
+                {
+                    const std::uint8_t* col = cols + std::size_t(t.column) * n + first;
+                    for (int i=0; i<len; i++) keep[i] &= std::uint8_t(unsigned(col[i]) - lo <= width) ^ flip;
+                }
+            }
+            for (const IdPrefix &id : q.ids)
+            {
+                for (int i=0; i<len; i++)
+                {
+                    std::uint64_t key = keys[first + i];
+                    if (key & ID_KEY_FALLBACK) keep[i] &= std::uint8_t(idMatches(studentId(gb, first + i), id));
+                    else keep[i] &= std::uint8_t(id.packs && key - id.lo <= id.hi - id.lo);
+                }
+            }
+            for (int i=0; i<len; i++)
+                if (keep[i]) found[p].push_back(first + i);
+        }
+    };
+    if (parts == 1) scan(0);
+    else gb.pool->run(parts, scan);
+    if (parts == 1) return std::move(found[0]);
+    for (const std::vector<int> &part : found) hits.insert(hits.end(), part.begin(), part.end());
+    return hits;
+}
+
+// Menu: students matching a filter, shown as the student list or by rank.
+void filterStudents(Gradebook &gb)
+{
+    using Clock = std::chrono::steady_clock;
+    if (gb.studentCount==0)
+    {
+        cout<<"No Students yet.\n";
+        return;
+    }
+    if (!batchInput)
+    {
+        cout<<"Terms: avg, t1..t"<<gb.testCount<<" or grade with < <= > >= = !=, id = PREFIX*, pass, fail.\n";
+        cout<<"Join terms with \"and\" or commas, e.g. fail and t3 > 80\n";
+    }
+    char text[QUERY_LEN];
+    readName("Filter: ", text, QUERY_LEN, 1);
+    if (inputAborted()) return;
+    Query q;
+    std::string error;
+    if (!parseQuery(gb, text, q, error))
+    {
+        commandError()<<"Bad filter: "<<error<<"\n";
+        return;
+    }
+    int view = readIntRange("1) List them  2) Rank them: ", 1, 2);
+    if (inputAborted()) return;
+
+    auto t0 = Clock::now();
+    std::vector<int> hits = runQuery(gb, q);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    cout<<hits.size()<<" of "<<gb.studentCount<<" students match ("<<std::fixed<<std::setprecision(2)<<ms<<" ms).\n";
+    if (hits.empty()) return;
+    if (view == 1)
+    {
+        printStudentList(gb, hits.data(), int(hits.size()));
+        return;
+    }
+    std::vector<RankEntry> ranked;
+    ranked.reserve(hits.size());
+    for (int row : hits) ranked.push_back(RankEntry{rowAverage(gb.agg.rows[row]), row});
+    std::sort(ranked.begin(), ranked.end(), [&gb](const RankEntry &a, const RankEntry &b) { return ranksAhead(gb, a, b); });
+    cout<<"\n-------- Matching Students by Class Rank --------\n\n";
+    ReportWriter out;
+    printRankingHeader(out);
+    for (const RankEntry &e : ranked) printRankingRow(out, gb, studentRank(gb, e.row), e);
+    out.text("\n");
+    out.flush();
+    restoreTableStreamState();
+}
+
+// ---------------- bulk CSV import (--import file.csv) ----------------
+// Each record is  id,name,mark1,...,markN  with an optional "id,name,..." header.
+// The file is memory-mapped and parsed in place; rows are validated exactly like
+// readId/readName/readIntRange and bad rows are reported by line number.
+
+struct CsvField
+{
+    const char* begin;
+    const char* end;
+    bool quoted;
+};
+
+// Splits [p, end) on commas into at most maxFields fields. Returns the number
+// of fields found, or maxFields + 1 if there were more.
+int splitCsvLine(const char* p, const char* end, CsvField* fields, int maxFields)
+{
+    int n = 0;
+    while (true)
+    {
+        while (p < end && (*p == ' ' || *p == '\t')) ++p; //like cin>>std::ws
+        CsvField f{p, p, false};
+        if (p < end && *p == '"')
+        {
+            f.quoted = true;
+            f.begin = ++p;
+            while (p < end && !(*p == '"' && (p + 1 == end || p[1] != '"'))) p += (*p == '"') ? 2 : 1;
+            f.end = p < end ? p : end;
+            if (p < end) ++p; //closing quote
+            while (p < end && *p != ',') ++p;
+        }
+        else
+        {
+            const char* comma = p < end ? static_cast<const char*>(std::memchr(p, ',', end - p)) : nullptr;
+            f.end = comma ? comma : end;
+            p = f.end;
+            while (f.end > f.begin && (f.end[-1] == ' ' || f.end[-1] == '\t')) --f.end;
+        }
+        if (n == maxFields) return maxFields + 1;
+        fields[n++] = f;
+        if (p >= end) return n;
+        ++p; //skip the comma
+    }
+}
+
+// Copies a field into out (NUL terminated, "" unescaped). False if it does not fit.
+bool copyCsvField(const CsvField &f, char* out, int maxsize)
+{
+    int len = 0;
+    for (const char* p = f.begin; p < f.end; ++p)
+    {
+        if (f.quoted && *p == '"') ++p; //"" -> "
+        if (len == maxsize - 1) return false;
+        out[len++] = *p;
+    }
+    out[len] = '\0';
+    return true;
+}
+
+// Same rules as readIntRange: a number (fractions truncate) between 0 and 100.
+// An empty field is a test that has not been graded yet.
+bool parseMark(const CsvField &f, Mark &mark)
+{
+    if (f.begin == f.end)
+    {
+        mark = MARK_UNGRADED;
+        return true;
+    }
+    double x{};
+    auto res = std::from_chars(f.begin, f.end, x);
+    if (res.ec != std::errc() || res.ptr != f.end || !(x > -1 && x < 101)) return false;
+    int v = static_cast<int>(x);
+    if (v < 0 || v > 100) return false;
+    mark = Mark(v);
+    return true;
+}
+
+// Loads every valid row of a CSV file into gb. If gb.testCount is still 0 it is
+// taken from the header (or the first record). Returns -1 if the file cannot be read.
+int importCsv(Gradebook &gb, const char* path)
+{
+    using Clock = std::chrono::steady_clock;
+    auto t0 = Clock::now();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        cout<<"Cannot open "<<path<<"\n";
+        return -1;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        cout<<"Cannot read "<<path<<"\n";
+        return -1;
+    }
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    const char* data = nullptr;
+    if (size > 0)
+    {
+        void* m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED)
+        {
+            close(fd);
+            cout<<"Cannot map "<<path<<"\n";
+            return -1;
+        }
+        madvise(m, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(m);
+    }
+    close(fd);
+
+    const char* p = data;
+    const char* end = data + size;
+
+    //one pass over the newlines is cheap and avoids regrowing the columns
+    int lines = 0;
+    for (const char* q = p; q < end; ++lines)
+    {
+        const char* nl = static_cast<const char*>(std::memchr(q, '\n', end - q));
+        q = nl ? nl + 1 : end;
+    }
+
+    CsvField fields[MAX_TESTS + 2];
+    char id[ID_LEN];
+    char name[NAME_LEN];
+    std::vector<Mark> row(MAX_TESTS);
+    int lineNo = 0, imported = 0, rejected = 0;
+
+    while (p < end)
+    {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = nl ? nl : end;
+        const char* next = nl ? nl + 1 : end;
+        if (lineEnd > p && lineEnd[-1] == '\r') --lineEnd;
+        ++lineNo;
+
+        const char* first = p;
+        while (first < lineEnd && (*first == ' ' || *first == '\t')) ++first;
+        if (first == lineEnd) { p = next; continue; } //blank line
+
+        int n = splitCsvLine(p, lineEnd, fields, MAX_TESTS + 2);
+        p = next;
+
+        if (lineNo == 1 && fields[0].end - fields[0].begin == 2
+            && std::tolower(static_cast<unsigned char>(fields[0].begin[0])) == 'i'
+            && std::tolower(static_cast<unsigned char>(fields[0].begin[1])) == 'd')
+        {
+            if (gb.testCount == 0 && n >= 3 && n <= MAX_TESTS + 2) gb.testCount = n - 2;
+            continue; //header
+        }
+        if (gb.testCount == 0)
+        {
+            if (n < 3 || n > MAX_TESTS + 2)
+            {
+                cout<<"  line "<<lineNo<<": expected id,name and 1 to "<<MAX_TESTS<<" marks\n";
+                ++rejected;
+                continue;
+            }
+            gb.testCount = n - 2;
+            reserveStudents(gb, gb.studentCount + lines);
+        }
+        if (n != gb.testCount + 2)
+        {
+            cout<<"  line "<<lineNo<<": expected "<<gb.testCount + 2<<" fields, found "
+                <<(n > MAX_TESTS + 2 ? "more" : std::to_string(n))<<"\n";
+            ++rejected;
+            continue;
+        }
+        if (!copyCsvField(fields[0], id, ID_LEN))
+        {
+            cout<<"  line "<<lineNo<<": ID too long (max "<<(ID_LEN - 1)<<" characters)\n";
+            ++rejected;
+            continue;
+        }
+        if (!normalizeId(id))
+        {
+            cout<<"  line "<<lineNo<<": ID must start with ets/ETS and include more characters after it\n";
+            ++rejected;
+            continue;
+        }
+        if (findStudentById(gb, id) > -1)
+        {
+            cout<<"  line "<<lineNo<<": duplicate ID "<<id<<"\n";
+            ++rejected;
+            continue;
+        }
+        if (!copyCsvField(fields[1], name, NAME_LEN) || name[0] == '\0')
+        {
+            cout<<"  line "<<lineNo<<": name must be 1 to "<<(NAME_LEN - 1)<<" characters\n";
+            ++rejected;
+            continue;
+        }
+        int bad = -1;
+        for (int i=0; i<gb.testCount && bad < 0; i++)
+        {
+            if (!parseMark(fields[i + 2], row[i])) bad = i;
+        }
+        if (bad >= 0)
+        {
+            cout<<"  line "<<lineNo<<": mark "<<(bad + 1)<<" must be a number between [0, 100] or empty\n";
+            ++rejected;
+            continue;
+        }
+        appendStudent(gb, id, name, row.data());
+        ++imported;
+    }
+
+    if (data) munmap(const_cast<char*>(data), size);
+
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    cout<<"Imported "<<imported<<" student(s) from "<<path<<" in "<<std::fixed<<std::setprecision(2)<<ms<<" ms";
+    if (ms > 0) cout<<" ("<<static_cast<long long>((imported + rejected) / (ms / 1000.0))<<" rows/s)";
+    cout<<", "<<rejected<<" row(s) rejected.\n";
+    return imported;
+}
+
+// ---------------- bulk mark updates ----------------
+// A file of id,test,mark lines (an id,... header line is skipped) changes many
+// cells at once, e.g. one assessment for the whole class after an exam. Every
+// line is parsed and its id resolved through the hash index before anything
+// changes, and one bad line rejects the whole file. The changes then go in as
+// one unit: one journal group, one write section on the class seqlock, and
+// each touched row's aggregate and rank refreshed once, however many of its
+// cells changed.
+
+struct MarkUpdate
+{
+    int row;
+    int test; //0-based
+    int value;
+};
+
+const int BULK_ERRORS_SHOWN = 10; //further bad lines are only counted
+
+// Parses and checks every line of path. Returns false, with the reasons
+// printed, if the file cannot be read or any line is invalid.
+bool readMarkUpdates(const Gradebook &gb, const char* path, std::vector<MarkUpdate> &updates)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st{};
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        if (fd >= 0) close(fd);
+        commandError()<<"Cannot open "<<path<<"\n";
+        return false;
+    }
+    MappedFile file;
+    file.size = static_cast<std::size_t>(st.st_size);
+    if (file.size > 0)
+    {
+        void* m = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED)
+        {
+            close(fd);
+            cout<<"Cannot map "<<path<<"\n";
+            return false;
+        }
+        madvise(m, file.size, MADV_SEQUENTIAL);
+        file.addr = m;
+    }
+    close(fd);
+
+    const char* p = static_cast<const char*>(file.addr);
+    const char* end = p + file.size;
+    CsvField fields[4];
+    char id[ID_LEN];
+    int lineNo = 0, errors = 0;
+    auto reject = [&](const char* why)
+    {
+        if (++errors <= BULK_ERRORS_SHOWN) cout<<"  line "<<lineNo<<": "<<why<<"\n";
+    };
+
+    updates.clear();
+    while (p < end)
+    {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = nl ? nl : end;
+        const char* next = nl ? nl + 1 : end;
+        if (lineEnd > p && lineEnd[-1] == '\r') --lineEnd;
+        ++lineNo;
+
+        const char* first = p;
+        while (first < lineEnd && (*first == ' ' || *first == '\t')) ++first;
+        if (first == lineEnd) { p = next; continue; } //blank line
+
+        int n = splitCsvLine(p, lineEnd, fields, 4);
+        p = next;
+        if (lineNo == 1 && fields[0].end - fields[0].begin == 2
+            && std::tolower(static_cast<unsigned char>(fields[0].begin[0])) == 'i'
+            && std::tolower(static_cast<unsigned char>(fields[0].begin[1])) == 'd') continue; //header
+
+        if (n != 3) { reject("expected id,test,mark"); continue; }
+        if (!copyCsvField(fields[0], id, ID_LEN) || !normalizeId(id)) { reject("not a valid student ID"); continue; }
+        int row = findStudentById(gb, id);
+        if (row < 0) { reject("student not found"); continue; }
+        int test = 0;
+        auto res = std::from_chars(fields[1].begin, fields[1].end, test);
+        if (res.ec != std::errc() || res.ptr != fields[1].end || test < 1 || test > gb.testCount)
+        {
+            std::string why = "test must be between [1, " + std::to_string(gb.testCount) + "]";
+            reject(why.c_str());
+            continue;
+        }
+        Mark mark;
+        if (!parseMark(fields[2], mark) || mark == MARK_UNGRADED) { reject("mark must be a number between [0, 100]"); continue; }
+        updates.push_back({row, test - 1, mark});
+    }
+    if (errors > BULK_ERRORS_SHOWN) cout<<"  ... and "<<(errors - BULK_ERRORS_SHOWN)<<" more\n";
+    if (errors > 0) cout<<path<<" rejected: "<<errors<<" bad line(s), nothing was changed.\n";
+    return errors == 0;
+}
+
+// Applies checked updates as one batch. When several update the same cell the
+// last one wins, as if they had been entered one by one.
+void applyMarkUpdates(Gradebook &gb, const std::vector<MarkUpdate> &updates)
+{
+    OpTimer timer(STAT_BULK_UPDATE);
+    int testCount = gb.testCount;
+    std::vector<int> touched;
+    std::vector<bool> seen(gb.studentCount);
+    for (const MarkUpdate &u : updates)
+    {
+        if (!seen[u.row]) touched.push_back(u.row);
+        seen[u.row] = true;
+    }
+    //past a few rows in eight, one rebuild (on next use) beats moving each row
+    bool rerank = gb.rank.built && touched.size() * 8 > std::size_t(gb.studentCount);
+    if (rerank) gb.rank.built = false;
+    else for (int row : touched) rankErase(gb, row);
+
+    SharedReads* shared = gb.shared.get();
+    if (shared)
+    {
+        seqBegin(shared->classSeq);
+        for (int row : touched) seqBegin(shared->rowSeq.get()[row]);
+    }
+    if (gb.journal) gb.journal->beginGroup();
+    for (const MarkUpdate &u : updates)
+    {
+        Mark &cell = studentRow(gb, u.row)[u.test];
+        if (cell <= 100) --gb.agg.markCounts[markBucket(u.test, cell)];
+        cell = Mark(u.value);
+        ++gb.agg.markCounts[markBucket(u.test, cell)];
+        if (!gb.testColumnsStale) gb.testColumns[std::size_t(u.test) * gb.studentCount + u.row] = std::uint8_t(u.value);
+        if (gb.journal) journalSet(*gb.journal, studentId(gb, u.row), u.test, u.value);
+    }
+    for (int row : touched)
+    {
+        RowAggregate &ra = gb.agg.rows[row];
+        uncountTotal(gb.agg, testCount, ra);
+        ra = rowAggregate(studentRow(gb, row), testCount);
+        countTotal(gb.agg, testCount, ra);
+    }
+    if (gb.journal) gb.journal->endGroup();
+    if (shared)
+    {
+        for (int row : touched) seqEnd(shared->rowSeq.get()[row]);
+        seqEnd(shared->classSeq);
+    }
+    if (!rerank) for (int row : touched) rankInsert(gb, row);
+}
+
+void bulkUpdateMarks(Gradebook &gb)
+{
+    using Clock = std::chrono::steady_clock;
+    char path[256];
+    readName("Updates file (id,test,mark per line): ", path, sizeof(path), 0);
+    if (inputAborted()) return;
+    auto t0 = Clock::now();
+    std::vector<MarkUpdate> updates;
+    if (!readMarkUpdates(gb, path, updates)) return;
+    applyMarkUpdates(gb, updates);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    cout<<"Applied "<<updates.size()<<" update(s) from "<<path<<" in "<<std::fixed<<std::setprecision(2)<<ms<<" ms.\n";
+}
+
+// ---------------- report card export ----------------
+// A report card for every student, as one CSV file, one JSON lines file, or
+// one text file per student in the "--- Student Report ---" layout. Pool
+// threads format chunks of EXPORT_CHUNK students, each into its own slot of a
+// small ring of buffers; a writer thread empties the ring in chunk order, so
+// the file comes out in row order and memory holds a few chunks however big
+// the class is. Text cards go to separate files, so the thread that formats a
+// card also writes it.
+
+enum ExportFormat { EXPORT_CSV = 1, EXPORT_JSONL, EXPORT_TEXT };
+
+const int EXPORT_CHUNK = 4096; //students per task
+const int EXPORT_SLOTS_PER_THREAD = 2;
+
+struct ExportRing
+{
+    std::vector<std::string> slots;
+    std::vector<char> ready;  //slot holds a formatted chunk the writer has not taken
+    std::mutex lock;
+    std::condition_variable changed;
+    int written = 0;          //chunks the writer has finished with
+};
+
+// A CSV field, quoted when it holds a comma, quote or line break.
+void appendCsvField(std::string &out, const char* s)
+{
+    if (!std::strpbrk(s, ",\"\r\n"))
+    {
+        out += s;
+        return;
+    }
+    out += '"';
+    for (; *s; ++s)
+    {
+        if (*s == '"') out += '"';
+        out += *s;
+    }
+    out += '"';
+}
+
+void appendJsonString(std::string &out, const char* s)
+{
+    out += '"';
+    for (; *s; ++s)
+    {
+        unsigned char c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\') { out += '\\'; out += char(c); }
+        else if (c < 0x20)
+        {
+            char tmp[8];
+            out.append(tmp, std::snprintf(tmp, sizeof(tmp), "\\u%04x", c));
+        }
+        else out += char(c);
+    }
+    out += '"';
+}
+
+std::string exportCsvHeader(int testCount)
+{
+    std::string h = "id,name";
+    for (int t=0; t<testCount; t++) h += ",test" + std::to_string(t + 1);
+    return h + ",total,minimum,highest,average,rank,percentile,grade,status\n";
+}
+
+// Appends one student's card. The rank index must already be built. A student
+// with no graded test has no minimum, highest, average, rank, percentile,
+// grade or status; like an ungraded mark they are empty in CSV, null in JSON
+// and "-" in text.
+void appendReportCard(std::string &out, Gradebook &gb, int row, int format, Mark* marks)
+{
+    int testCount = gb.testCount;
+    RowAggregate ra;
+    readStudent(gb, row, marks, ra);
+    bool graded = ra.graded > 0;
+    double avg = rowAverage(ra);
+    int rank = studentRank(gb, row);
+    int ranked = rankedStudents(gb);
+    double percentile = rankPercentile(rank, ranked);
+    std::string_view grade = letterGrade(avg);
+    const char* status = passStatus(avg);
+
+    if (format == EXPORT_CSV)
+    {
+        appendCsvField(out, studentId(gb, row));
+        out += ',';
+        appendCsvField(out, studentName(gb, row));
+        for (int t=0; t<testCount; t++)
+        {
+            out += ',';
+            if (marks[t] != MARK_UNGRADED) appendInt(out, marks[t]);
+        }
+        out += ','; appendInt(out, static_cast<long long>(ra.total));
+        if (!graded)
+        {
+            out += ",,,,,,,\n";
+            return;
+        }
+        out += ','; appendInt(out, ra.low);
+        out += ','; appendInt(out, ra.high);
+        out += ','; appendFixed2(out, avg);
+        out += ','; appendInt(out, rank);
+        out += ','; appendFixed2(out, percentile);
+        out += ','; out += grade;
+        out += ','; out += status;
+        out += '\n';
+    }
+    else if (format == EXPORT_JSONL)
+    {
+        out += "{\"id\":"; appendJsonString(out, studentId(gb, row));
+        out += ",\"name\":"; appendJsonString(out, studentName(gb, row));
+        out += ",\"marks\":[";
+        for (int t=0; t<testCount; t++)
+        {
+            if (t > 0) out += ',';
+            if (marks[t] == MARK_UNGRADED) out += "null";
+            else appendInt(out, marks[t]);
+        }
+        out += "],\"total\":"; appendInt(out, static_cast<long long>(ra.total));
+        if (!graded)
+        {
+            out += ",\"minimum\":null,\"highest\":null,\"average\":null,\"rank\":null,\"percentile\":null";
+            out += ",\"grade\":null,\"status\":null}\n";
+            return;
+        }
+        out += ",\"minimum\":"; appendInt(out, ra.low);
+        out += ",\"highest\":"; appendInt(out, ra.high);
+        out += ",\"average\":"; appendFixed2(out, avg);
+        out += ",\"rank\":"; appendInt(out, rank);
+        out += ",\"percentile\":"; appendFixed2(out, percentile);
+        out += ",\"grade\":\""; out += grade;
+        out += "\",\"status\":\""; out += status;
+        out += "\"}\n";
+    }
+    else
+    {
+        out += "--- Student Report ---\n\n";
+        out += "ID:           "; out += studentId(gb, row);
+        out += "\nName:         "; out += studentName(gb, row);
+        out += "\nMarks:        ";
+        for (int t=0; t<testCount; t++)
+        {
+            if (marks[t] == MARK_UNGRADED) out += '-';
+            else appendFixed2(out, marks[t]);
+            if (t + 1 < testCount) out += ", ";
+        }
+        out += "\nTotal:        "; appendFixed2(out, ra.total);
+        if (!graded)
+        {
+            out += "\nMinimum Mark: -\nHighest Mark: -\nAverage:      -\nRank:         -\nPercentile:   -";
+            out += "\nGrade:        -    \nStatus:       -\n\n";
+            return;
+        }
+        out += "\nMinimum Mark: "; appendInt(out, ra.low);
+        out += "\nHighest Mark: "; appendInt(out, ra.high);
+        out += "\nAverage:      "; appendFixed2(out, avg);
+        out += "\nRank:         "; appendInt(out, rank);
+        out += " of "; appendInt(out, ranked);
+        out += "\nPercentile:   "; appendFixed2(out, percentile);
+        out += "\nGrade:        "; out += grade;
+        out.append(grade.size() < 5 ? 5 - grade.size() : 0, ' ');
+        out += "\nStatus:       "; out += status;
+        out += "\n\n";
+    }
+}
+
+// dir/<id>.txt with every byte of the id other than a letter, digit, '-' or
+// '_' written as %XX, so an id can't name a path outside dir ("/", "..") or a
+// hidden file, and two ids never share a file name.
+std::string exportFileName(const char* dir, const char* id)
+{
+    static const char HEX[] = "0123456789ABCDEF";
+    std::string path = std::string(dir) + "/";
+    for (const char* p = id; *p; ++p)
+    {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (std::isalnum(c) || c == '-' || c == '_') path += char(c);
+        else
+        {
+            path += '%';
+            path += HEX[c >> 4];
+            path += HEX[c & 15];
+        }
+    }
+    return path + ".txt";
+}
+
+// Cards for rows [begin, end) into out; text cards are written to the file
+// exportFileName gives. Returns the number of text files that could not be written.
+int formatExportChunk(Gradebook &gb, int format, const char* dir, int begin, int end, std::string &out)
+{
+    ReadGuard guard(gb.shared.get());
+    std::vector<Mark> marks(gb.testCount);
+    int failed = 0;
+    out.clear();
+    for (int row=begin; row<end; row++)
+    {
+        if (format != EXPORT_TEXT)
+        {
+            appendReportCard(out, gb, row, format, marks.data());
+            continue;
+        }
+        out.clear();
+        appendReportCard(out, gb, row, format, marks.data());
+        std::string path = exportFileName(dir, studentId(gb, row));
+        //O_NOFOLLOW: a symlink planted in dir is refused rather than written through
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0644);
+        if (fd < 0 || !writeAll(fd, out.data(), out.size())) ++failed;
+        if (fd >= 0) close(fd);
+    }
+    return failed;
+}
+
+// Writes every student's card to path (a file, or a directory for text
+// cards). Returns false, with the reason printed, if anything failed.
+bool exportReportCards(Gradebook &gb, int format, const char* path)
+{
+    OpTimer timer(STAT_EXPORT);
+    int n = gb.studentCount;
+    if (n > 0 && !gb.rank.built) buildRankIndex(gb); //every card reads it, pool threads included
+    int fd = -1;
+    if (format == EXPORT_TEXT)
+    {
+        if (mkdir(path, 0755) != 0 && errno != EEXIST)
+        {
+            cout<<"Cannot create "<<path<<"\n";
+            return false;
+        }
+    }
+    else
+    {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            cout<<"Cannot create "<<path<<"\n";
+            return false;
+        }
+    }
+
+    bool writeOk = true;
+    if (format == EXPORT_CSV)
+    {
+        std::string header = exportCsvHeader(gb.testCount);
+        writeOk = writeAll(fd, header.data(), header.size());
+    }
+    int chunks = (n + EXPORT_CHUNK - 1) / EXPORT_CHUNK;
+    std::atomic<int> failedFiles{0};
+    auto rows = [&](int c, int &begin, int &end)
+    {
+        begin = c * EXPORT_CHUNK;
+        end = std::min(n, begin + EXPORT_CHUNK);
+    };
+
+    if (!gb.pool || gb.pool->size() == 1 || chunks <= 1)
+    {
+        std::string buf;
+        for (int c=0; c<chunks; c++)
+        {
+            int begin, end;
+            rows(c, begin, end);
+            failedFiles += formatExportChunk(gb, format, path, begin, end, buf);
+            if (fd >= 0 && writeOk) writeOk = writeAll(fd, buf.data(), buf.size());
+        }
+    }
+    else
+    {
+        ExportRing ring;
+        int slotCount = EXPORT_SLOTS_PER_THREAD * gb.pool->size();
+        ring.slots.resize(slotCount);
+        ring.ready.assign(slotCount, 0);
+        std::thread writer([&]
+        {
+            for (int c=0; c<chunks; c++)
+            {
+                int slot = c % slotCount;
+                {
+                    std::unique_lock<std::mutex> held(ring.lock);
+                    ring.changed.wait(held, [&] { return ring.ready[slot] != 0; });
+                }
+                const std::string &buf = ring.slots[slot];
+                if (fd >= 0 && writeOk) writeOk = writeAll(fd, buf.data(), buf.size());
+                std::lock_guard<std::mutex> held(ring.lock);
+                ring.ready[slot] = 0;
+                ring.written = c + 1;
+                ring.changed.notify_all();
+            }
+        });
+        //chunks are handed out in order, so chunk c - slotCount is always
+        //already being formatted when chunk c waits for its slot
+        gb.pool->run(chunks, [&](int c)
+        {
+            int slot = c % slotCount;
+            {
+                std::unique_lock<std::mutex> held(ring.lock);
+                ring.changed.wait(held, [&] { return ring.written > c - slotCount; });
+            }
+            int begin, end;
+            rows(c, begin, end);
+            failedFiles += formatExportChunk(gb, format, path, begin, end, ring.slots[slot]);
+            std::lock_guard<std::mutex> held(ring.lock);
+            ring.ready[slot] = 1;
+            ring.changed.notify_all();
+        });
+        writer.join();
+    }
+    if (fd >= 0 && close(fd) != 0) writeOk = false;
+    if (!writeOk) cout<<"Could not write "<<path<<"\n";
+    if (failedFiles > 0) cout<<"Could not write "<<failedFiles<<" report file(s) in "<<path<<"\n";
+    return writeOk && failedFiles == 0;
+}
+
+void exportAllReports(Gradebook &gb)
+{
+    using Clock = std::chrono::steady_clock;
+    if (gb.studentCount == 0)
+    {
+        cout<<"No Students yet.\n";
+        return;
+    }
+    int format = readIntRange("1) CSV  2) JSON lines  3) One text file per student: ", 1, 3);
+    char path[256];
+    readName(format == EXPORT_TEXT ? "Output directory: " : "Output file: ", path, sizeof(path), 0);
+    if (inputAborted()) return;
+    auto t0 = Clock::now();
+    if (!exportReportCards(gb, format, path)) return;
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    cout<<"Exported "<<gb.studentCount<<" report card(s) to "<<path<<" in "<<std::fixed<<std::setprecision(2)<<ms<<" ms.\n";
+}
+
+// ---------------- binary snapshot (--snapshot file) ----------------
+// Layout: SnapshotHeader, then the ids, name offsets, name pool, marks and id
+// index columns, then the cached aggregates (row aggregates and the total,
+// partial and mark histograms), each starting on an 8-byte boundary and stored
+// exactly as they are kept in memory. Opening a snapshot maps the file and
+// points the columns at it; nothing is parsed or copied until a column is
+// modified, except the row aggregates, which are one memcpy into gb.agg. The
+// packed id keys (version 5) are stored after the aggregates so they are not
+// re-packed from the ids on every open.
+// Version 1 stored marks as doubles; such files still open, their marks
+// converted to bytes. Versions before 4 carry no aggregates; they are rebuilt
+// from the marks on open. Versions before 5 have their id keys packed on open.
+// Versions before 6 filed the students with no graded test at average step 0;
+// they are taken back out of the partial histogram on open.
+
+const char SNAPSHOT_MAGIC[8] = {'G','B','S','N','A','P','\0','\0'};
+//3: the index is hashed on packed id keys, 4: aggregates stored, 5: id keys stored,
+//6: ungraded students kept out of the histograms (layout as in 5)
+const std::uint32_t SNAPSHOT_VERSION = 6;
+const int SNAPSHOT_COLUMNS = 10;
+const int SNAPSHOT_V4_COLUMNS = 9;
+const int SNAPSHOT_V3_COLUMNS = 5; //the columns before version 4
+
+int snapshotColumnCount(std::uint32_t version)
+{
+    if (version >= 5) return SNAPSHOT_COLUMNS;
+    return version == 4 ? SNAPSHOT_V4_COLUMNS : SNAPSHOT_V3_COLUMNS;
+}
+
+// The header of a file with Columns columns; older versions have fewer.
+template <int Columns>
+struct SnapshotHeaderLayout
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t idLen;
+    std::uint32_t markBytes;
+    std::uint32_t testCount;
+    std::uint64_t studentCount;
+    std::uint64_t namePoolBytes;
+    std::uint64_t indexSlots;
+    std::uint64_t fileSize;
+    std::uint64_t columnOffset[Columns];
+    std::uint64_t bodyChecksum;   //all columns, in order
+    std::uint64_t headerChecksum; //this struct with headerChecksum = 0
+};
+
+using SnapshotHeader = SnapshotHeaderLayout<SNAPSHOT_COLUMNS>;
+
+// Reads a header laid out with Columns columns into the current layout, the
+// missing columns left at offset 0. False if its checksum does not match.
+template <int Columns>
+bool readSnapshotHeader(const char* base, SnapshotHeader &h)
+{
+    SnapshotHeaderLayout<Columns> stored;
+    std::memcpy(&stored, base, sizeof(stored));
+    std::uint64_t sum = stored.headerChecksum;
+    stored.headerChecksum = 0;
+    h = SnapshotHeader{};
+    std::memcpy(h.magic, stored.magic, sizeof(h.magic));
+    h.version = stored.version;
+    h.idLen = stored.idLen;
+    h.markBytes = stored.markBytes;
+    h.testCount = stored.testCount;
+    h.studentCount = stored.studentCount;
+    h.namePoolBytes = stored.namePoolBytes;
+    h.indexSlots = stored.indexSlots;
+    h.fileSize = stored.fileSize;
+    for (int c=0; c<Columns; c++) h.columnOffset[c] = stored.columnOffset[c];
+    h.bodyChecksum = stored.bodyChecksum;
+    return checksum64(&stored, sizeof(stored), 0) == sum;
+}
+
+std::size_t snapshotHeaderBytes(int columns)
+{
+    if (columns == SNAPSHOT_COLUMNS) return sizeof(SnapshotHeader);
+    if (columns == SNAPSHOT_V4_COLUMNS) return sizeof(SnapshotHeaderLayout<SNAPSHOT_V4_COLUMNS>);
+    return sizeof(SnapshotHeaderLayout<SNAPSHOT_V3_COLUMNS>);
+}
+
+// readSnapshotHeader for the layout that a file with `columns` columns uses.
+bool readSnapshotHeader(const char* base, int columns, SnapshotHeader &h)
+{
+    if (columns == SNAPSHOT_COLUMNS) return readSnapshotHeader<SNAPSHOT_COLUMNS>(base, h);
+    if (columns == SNAPSHOT_V4_COLUMNS) return readSnapshotHeader<SNAPSHOT_V4_COLUMNS>(base, h);
+    return readSnapshotHeader<SNAPSHOT_V3_COLUMNS>(base, h);
+}
+
+struct SnapshotColumn
+{
+    const void* data;
+    std::size_t bytes;
+};
+
+void snapshotColumns(const Gradebook &gb, SnapshotColumn cols[SNAPSHOT_COLUMNS])
+{
+    std::size_t n = gb.studentCount;
+    cols[0] = {gb.ids.data(), n * ID_LEN};
+    cols[1] = {gb.nameOffsets.data(), n * sizeof(std::uint32_t)};
+    cols[2] = {gb.namePool.data(), gb.namePool.size()};
+    cols[3] = {gb.marks.data(), n * gb.testCount * sizeof(Mark)};
+    cols[4] = {gb.index.slots.data(), gb.index.slots.size() * sizeof(int)};
+    //an empty class has no aggregates yet (appendStudent builds them)
+    const ClassAggregates &agg = gb.agg;
+    bool built = n > 0;
+    cols[5] = {agg.rows.data(), n * sizeof(RowAggregate)};
+    cols[6] = {agg.totalCounts.data(), built ? agg.totalCounts.size() * sizeof(int) : 0};
+    cols[7] = {agg.partialCounts.data(), built ? agg.partialCounts.size() * sizeof(int) : 0};
+    cols[8] = {agg.markCounts.data(), built ? agg.markCounts.size() * sizeof(int) : 0};
+    cols[9] = {gb.idKeys.data(), n * sizeof(std::uint64_t)};
+}
+
+// Writes gb to path atomically: a temp file is written and fsync'ed, then
+// renamed over the old snapshot, so a crash never leaves a torn file behind.
+bool saveSnapshot(const Gradebook &gb, const char* path)
+{
+    SnapshotColumn cols[SNAPSHOT_COLUMNS];
+    snapshotColumns(gb, cols);
+
+    SnapshotHeader h{};
+    std::memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.idLen = ID_LEN;
+    h.markBytes = sizeof(Mark);
+    h.testCount = gb.testCount;
+    h.studentCount = gb.studentCount;
+    h.namePoolBytes = gb.namePool.size();
+    h.indexSlots = gb.index.slots.size();
+    std::uint64_t offset = sizeof(SnapshotHeader);
+    h.bodyChecksum = SNAPSHOT_VERSION;
+    for (int c=0; c<SNAPSHOT_COLUMNS; c++)
+    {
+        offset = (offset + 7) & ~std::uint64_t(7);
+        h.columnOffset[c] = offset;
+        offset += cols[c].bytes;
+        h.bodyChecksum = checksum64(cols[c].data, cols[c].bytes, h.bodyChecksum);
+    }
+    h.fileSize = offset;
+    h.headerChecksum = checksum64(&h, sizeof(h), 0);
+
+    std::string tmp = std::string(path) + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = writeAll(fd, &h, sizeof(h));
+    std::uint64_t written = sizeof(h);
+    const char zeros[8] = {};
+    for (int c=0; ok && c<SNAPSHOT_COLUMNS; c++)
+    {
+        ok = writeAll(fd, zeros, h.columnOffset[c] - written)
+            && writeAll(fd, cols[c].data, cols[c].bytes);
+        written = h.columnOffset[c] + cols[c].bytes;
+    }
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (ok && std::rename(tmp.c_str(), path) == 0) return true;
+    unlink(tmp.c_str());
+    return false;
+}
+
+// The invariants the readers rely on instead of checking: every id and the
+// name pool end in a NUL, every name offset lies inside the pool, and the
+// index holds each row once with nothing out of range (so a probe always
+// meets an empty slot). A strided pass over three columns, far cheaper than
+// the checksum, and run even without verify so a corrupt file is refused
+// instead of read out of bounds. The extents must already be checked.
+bool snapshotBodySane(const char* base, const SnapshotHeader &h)
+{
+    std::uint64_t n = h.studentCount;
+    const char* ids = base + h.columnOffset[0];
+    const std::uint32_t* offsets = reinterpret_cast<const std::uint32_t*>(base + h.columnOffset[1]);
+    const char* pool = base + h.columnOffset[2];
+    const int* slots = reinterpret_cast<const int*>(base + h.columnOffset[4]);
+    if (n > 0 && (h.namePoolBytes == 0 || pool[h.namePoolBytes - 1] != '\0')) return false;
+    for (std::uint64_t i=0; i<n; i++)
+    {
+        if (ids[i * ID_LEN + ID_LEN - 1] != '\0' || offsets[i] >= h.namePoolBytes) return false;
+    }
+    if (h.version >= 5)
+    {
+        //the keys are only ever compared; this refuses values packId never makes
+        const std::uint64_t* keys = reinterpret_cast<const std::uint64_t*>(base + h.columnOffset[9]);
+        for (std::uint64_t i=0; i<n; i++)
+        {
+            if (!(keys[i] & ID_KEY_FALLBACK) && keys[i] >= ID_KEY_LIMIT) return false;
+        }
+    }
+    std::uint64_t used = 0;
+    for (std::uint64_t s=0; s<h.indexSlots; s++)
+    {
+        if (slots[s] < 0 || std::uint64_t(slots[s]) > n) return false;
+        used += slots[s] != 0;
+    }
+    if (used != n) return false;
+    if (h.version < 4 || n == 0) return true;
+    //the aggregates: rows in range (so bucket lookups stay in bounds) and one
+    //histogram entry per graded student (before version 6, per student)
+    const RowAggregate* rows = reinterpret_cast<const RowAggregate*>(base + h.columnOffset[5]);
+    std::uint64_t ungraded = 0;
+    for (std::uint64_t i=0; i<n; i++)
+    {
+        const RowAggregate &ra = rows[i];
+        if (!(ra.graded >= 0 && ra.graded <= int(h.testCount) && ra.total >= 0 && ra.total <= 100.0 * ra.graded)) return false;
+        if (ra.graded == 0) ungraded++;
+    }
+    const int* totals = reinterpret_cast<const int*>(base + h.columnOffset[6]);
+    const int* partial = reinterpret_cast<const int*>(base + h.columnOffset[7]);
+    std::uint64_t filed = 0;
+    for (std::uint64_t b=0; b<100ULL * h.testCount + 1; b++)
+    {
+        if (totals[b] < 0) return false;
+        filed += totals[b];
+    }
+    for (int s=0; s<GRADE_STEPS; s++)
+    {
+        if (partial[s] < 0) return false;
+        filed += partial[s];
+    }
+    if (h.version < 6) return filed == n && std::uint64_t(partial[0]) >= ungraded;
+    return filed + ungraded == n;
+}
+
+// Maps a snapshot and serves gb's columns straight from it. The header and
+// the cheap structural invariants are always validated; the body checksum
+// runs only when verify is set.
+bool openSnapshot(Gradebook &gb, const char* path, bool verify, std::string &error)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        error = "cannot open file";
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(SnapshotHeaderLayout<SNAPSHOT_V3_COLUMNS>))
+    {
+        close(fd);
+        error = "file is too short";
+        return false;
+    }
+    auto file = std::make_shared<MappedFile>();
+    file->size = static_cast<std::size_t>(st.st_size);
+    file->addr = mmap(nullptr, file->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file->addr == MAP_FAILED)
+    {
+        file->addr = nullptr;
+        error = "cannot map file";
+        return false;
+    }
+    const char* base = static_cast<const char*>(file->addr);
+
+    //magic and version sit at the same place in every layout
+    SnapshotHeader h;
+    std::memcpy(h.magic, base, sizeof(h.magic));
+    std::memcpy(&h.version, base + sizeof(h.magic), sizeof(h.version));
+    if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0) { error = "not a gradebook snapshot"; return false; }
+    if (h.version < 1 || h.version > SNAPSHOT_VERSION) { error = "unsupported version " + std::to_string(h.version); return false; }
+    int columns = snapshotColumnCount(h.version);
+    std::size_t headerBytes = snapshotHeaderBytes(columns);
+    if (file->size < headerBytes) { error = "file is too short"; return false; }
+    if (!readSnapshotHeader(base, columns, h)) { error = "header checksum mismatch"; return false; }
+    if (h.fileSize != file->size) { error = "file size does not match header (torn write?)"; return false; }
+    std::size_t markBytes = h.version == 1 ? sizeof(double) : sizeof(Mark);
+    if (h.idLen != ID_LEN || h.markBytes != markBytes) { error = "snapshot was written by a different program"; return false; }
+    if (h.testCount < 1 || h.testCount > std::uint32_t(MAX_TESTS) || h.studentCount > 0x7fffffffULL)
+    {
+        error = "bad header";
+        return false;
+    }
+    std::uint64_t n = h.studentCount;
+    //bounded first, so the byte counts below cannot wrap
+    bool slotsOk = h.indexSlots <= h.fileSize / sizeof(int) && h.namePoolBytes <= h.fileSize
+        && (n == 0 || (h.indexSlots >= 2 * n && (h.indexSlots & (h.indexSlots - 1)) == 0));
+    std::uint64_t aggBytes = n > 0 ? sizeof(int) : 0; //an empty class stores no histograms
+    std::uint64_t bytes[SNAPSHOT_COLUMNS] = {
+        n * ID_LEN, n * sizeof(std::uint32_t), h.namePoolBytes,
+        n * h.testCount * markBytes, h.indexSlots * sizeof(int),
+        n * sizeof(RowAggregate), (100ULL * h.testCount + 1) * aggBytes,
+        std::uint64_t(GRADE_STEPS) * aggBytes, 101ULL * h.testCount * aggBytes,
+        n * sizeof(std::uint64_t)};
+    for (int c=0; c<columns && slotsOk; c++)
+    {
+        slotsOk = h.columnOffset[c] % 8 == 0 && h.columnOffset[c] >= headerBytes
+            && h.columnOffset[c] <= h.fileSize && bytes[c] <= h.fileSize - h.columnOffset[c];
+    }
+    if (!slotsOk)
+    {
+        error = "column table is inconsistent";
+        return false;
+    }
+    if (!snapshotBodySane(base, h))
+    {
+        error = "column contents are inconsistent (file is corrupt)";
+        return false;
+    }
+    if (verify)
+    {
+        std::uint64_t sum = h.version;
+        for (int c=0; c<columns; c++) sum = checksum64(base + h.columnOffset[c], bytes[c], sum);
+        if (sum != h.bodyChecksum)
+        {
+            error = "data checksum mismatch (file is corrupt)";
+            return false;
+        }
+    }
+
+    ThreadPool* pool = gb.pool;
+    gb = Gradebook();
+    gb.pool = pool;
+    gb.testCount = h.testCount;
+    gb.studentCount = static_cast<int>(n);
+    gb.capacity = gb.studentCount;
+    gb.ids.borrow(base + h.columnOffset[0], bytes[0]);
+    gb.nameOffsets.borrow(reinterpret_cast<const std::uint32_t*>(base + h.columnOffset[1]), n);
+    gb.namePool.borrow(base + h.columnOffset[2], bytes[2]);
+    if (h.version == 1)
+    {
+        const double* old = reinterpret_cast<const double*>(base + h.columnOffset[3]);
+        std::vector<Mark> &marks = gb.marks.own();
+        marks.resize(n * h.testCount);
+        for (std::size_t i=0; i<marks.size(); i++) marks[i] = old[i] >= 0 && old[i] <= 100 ? Mark(old[i]) : Mark(0);
+    }
+    else gb.marks.borrow(reinterpret_cast<const Mark*>(base + h.columnOffset[3]), n * h.testCount);
+    gb.index.slots.borrow(reinterpret_cast<const int*>(base + h.columnOffset[4]), h.indexSlots);
+    gb.index.used = gb.studentCount;
+    if (h.version >= 5) gb.idKeys.borrow(reinterpret_cast<const std::uint64_t*>(base + h.columnOffset[9]), n);
+    else
+    {
+        std::vector<std::uint64_t> &keys = gb.idKeys.own();
+        keys.resize(n);
+        for (std::size_t i=0; i<n; i++) keys[i] = packId(gb.ids.data() + i * ID_LEN);
+    }
+    if (h.version < 3) idIndexRehash(gb.index, gb, h.indexSlots);
+    gb.snapshot = file;
+    if (h.version < 4) rebuildAggregates(gb);
+    else if (n > 0)
+    {
+        ClassAggregates &agg = gb.agg;
+        const RowAggregate* rows = reinterpret_cast<const RowAggregate*>(base + h.columnOffset[5]);
+        const int* totals = reinterpret_cast<const int*>(base + h.columnOffset[6]);
+        const int* partial = reinterpret_cast<const int*>(base + h.columnOffset[7]);
+        const int* marks = reinterpret_cast<const int*>(base + h.columnOffset[8]);
+        agg.rows.assign(rows, rows + n);
+        agg.totalCounts.assign(totals, totals + bytes[6] / sizeof(int));
+        agg.partialCounts.assign(partial, partial + GRADE_STEPS);
+        agg.markCounts.assign(marks, marks + bytes[8] / sizeof(int));
+        if (h.version < 6)
+        {
+            for (std::size_t i=0; i<n; i++)
+                if (rows[i].graded == 0) agg.partialCounts[0]--;
+        }
+        summarizeHistograms(agg, gb.testCount);
+    }
+    return true;
+}
+
+// End of the intact record at pos, or 0 if it is torn or corrupt.
+std::size_t journalRecordEnd(const char* base, std::size_t size, std::size_t pos)
+{
+    if (size - pos < 4) return 0;
+    std::uint32_t length;
+    std::memcpy(&length, base + pos, 4);
+    if (length < 1 || length > 1 + 512 || size - pos < 4 + std::size_t(length) + 4) return 0;
+    const char* rec = base + pos + 4;
+    std::uint32_t sum;
+    std::memcpy(&sum, rec + length, 4);
+    if (sum != static_cast<std::uint32_t>(checksum64(rec, length, 0))) return 0;
+    return pos + 4 + length + 4;
+}
+
+// Applies every intact, committed journal record to gb (which has no journal
+// attached yet, so nothing is logged twice). validBytes receives the offset
+// just past the last such record: a torn or corrupt tail ends the replay
+// there, and so does a group that was never committed.
+bool replayJournal(Gradebook &gb, const char* path, std::uint64_t &validBytes, long long &applied, std::string &error)
+{
+    validBytes = 0;
+    applied = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return true; //no journal yet
+    struct stat st{};
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        error = "cannot read file";
+        return false;
+    }
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    if (size == 0)
+    {
+        close(fd);
+        return true;
+    }
+    void* m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+    {
+        error = "cannot map file";
+        return false;
+    }
+    const char* base = static_cast<const char*>(m);
+    madvise(m, size, MADV_SEQUENTIAL);
+
+    JournalHeader h{};
+    bool headerOk = size >= sizeof(h);
+    if (headerOk) std::memcpy(&h, base, sizeof(h));
+    headerOk = headerOk && std::memcmp(h.magic, JOURNAL_MAGIC, sizeof(h.magic)) == 0
+        && h.version == JOURNAL_VERSION && h.checksum == journalHeaderChecksum(h);
+    if (!headerOk || h.idLen != ID_LEN || h.testCount < 1 || h.testCount > std::uint32_t(MAX_TESTS)
+        || (gb.testCount != 0 && h.testCount != std::uint32_t(gb.testCount)))
+    {
+        munmap(m, size);
+        error = !headerOk ? "not a gradebook journal" : "journal belongs to a different gradebook";
+        return false;
+    }
+    gb.testCount = h.testCount;
+
+    //first pass: where the committed records end
+    std::size_t committed = sizeof(h);
+    bool inGroup = false;
+    for (std::size_t pos = sizeof(h), next; (next = journalRecordEnd(base, size, pos)) != 0; pos = next)
+    {
+        if (base[pos + 4] == JOURNAL_BEGIN) inGroup = true;
+        else if (base[pos + 4] == JOURNAL_COMMIT) inGroup = false;
+        if (!inGroup) committed = next;
+    }
+
+    std::vector<Mark> row(gb.testCount);
+    char id[ID_LEN];
+    char name[NAME_LEN];
+    for (std::size_t pos = sizeof(h); pos < committed; )
+    {
+        std::uint32_t length;
+        std::memcpy(&length, base + pos, 4);
+        const char* rec = base + pos + 4;
+        pos += 4 + length + 4; //checked by the first pass
+        if (rec[0] == JOURNAL_BEGIN || rec[0] == JOURNAL_COMMIT) continue;
+
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(rec) + 1;
+        const unsigned char* end = reinterpret_cast<const unsigned char*>(rec) + length;
+        std::size_t idLen = p < end ? *p++ : ID_LEN;
+        bool ok = idLen < ID_LEN && std::size_t(end - p) >= idLen;
+        if (ok)
+        {
+            std::memcpy(id, p, idLen);
+            id[idLen] = '\0';
+            p += idLen;
+        }
+        if (ok && rec[0] == JOURNAL_ADD)
+        {
+            std::size_t nameLen = p < end ? *p++ : NAME_LEN;
+            ok = nameLen < NAME_LEN && std::size_t(end - p) == nameLen + gb.testCount;
+            if (ok)
+            {
+                std::memcpy(name, p, nameLen);
+                name[nameLen] = '\0';
+                p += nameLen;
+                for (int i=0; i<gb.testCount; i++) row[i] = p[i] <= 100 ? p[i] : MARK_UNGRADED;
+                if (findStudentById(gb, id) < 0)
+                {
+                    appendStudent(gb, id, name, row.data());
+                    ++applied;
+                }
+            }
+        }
+        else if (ok && rec[0] == JOURNAL_SET && end - p == 2)
+        {
+            int idx = findStudentById(gb, id);
+            if (idx >= 0 && p[0] < gb.testCount && p[1] <= 100)
+            {
+                setMark(gb, idx, p[0], p[1]);
+                ++applied;
+            }
+        }
+    }
+    munmap(m, size);
+    validBytes = committed;
+    return true;
+}
+
+// ---------------- menus ----------------
+
+// The single-course menu. Returns when 0 is chosen or a script runs out; a
+// course opened from the course list (inCourse) goes back to that list.
+void runMenu(Gradebook &gb, Journal &journal, const char* snapshotPath, bool inCourse)
+{
+    while (true)
+    {
+        if (!batchInput)
+        {
+            cout << "\nMenu\n";
+            cout << " 1) Add a student record\n";
+            cout << " 2) Update a student's assessment score\n";
+            cout << " 3) Generate an individual student report\n";
+            cout << " 4) Generate class summary and performance ranking\n";
+            cout << " 5) Display all student records\n";
+            cout << " 6) Save a snapshot and compact the journal\n";
+            cout << " 7) Show the top or bottom students, or a range of ranks\n";
+            cout << " 8) Show per-assessment statistics\n";
+            cout << " 9) Show operation statistics\n";
+            cout << "10) Apply a file of assessment scores\n";
+            cout << "11) Export every student's report card\n";
+            cout << "12) Display all student records in ID order\n";
+            cout << "13) Find students matching a filter\n";
+            cout << "14) Find students by name\n";
+            cout << (inCourse ? " 0) Back to the course list\n" : " 0) Exit the program\n");
+        }
+        else batchNextCommand(*batchInput);
+
+        int choice = readIntRange("Choice: ", 0, 14);
+        if (inputEnded()) return;
+        if (inputAborted()) continue;
+        if (choice==0)
+        {
+            if (!inCourse) cout<<"\nGood Bay!\n";
+            return;
+        }
+        if (batchInput) batchInput->inCommand = true;
+        OpTimer timer(STAT_MENU_ADD + choice - 1); //the menu dispatch, prompts included
+        switch (choice)
+        {
+            case 1: addStudent(gb); break;
+            case 2: updateMarks(gb); break;
+            case 3: printStudentReport(gb); break;
+            case 4: classSummaryAndRanging(gb); break;
+            case 5: listStudents(gb, false); break;
+            case 6:
+                if (!snapshotPath) cout<<"Start the program with --snapshot FILE to save.\n";
+                else if (journal.flush(), !saveSnapshot(gb, snapshotPath)) cout<<"Could not write "<<snapshotPath<<"\n";
+                else if (gb.journal && !resetJournal(journal)) cout<<"Saved, but the journal could not be emptied.\n";
+                else cout<<"Saved "<<gb.studentCount<<" students to "<<snapshotPath<<".\n";
+                break;
+            case 7: showTopStudents(gb); break;
+            case 8: showAssessmentStats(gb); break;
+            case 9: writeOpStats(cout); break;
+            case 10: bulkUpdateMarks(gb); break;
+            case 11: exportAllReports(gb); break;
+            case 12: listStudents(gb, true); break;
+            case 13: filterStudents(gb); break;
+            case 14: findByName(gb); break;
+        }
+    }
+}
+
+// ---------------- multi-course store (--courses DIR) ----------------
+// Every CSV file in DIR is one course, named after the file. A course is a
+// shard: a Gradebook of its own, with its own columns, id index, aggregates,
+// rank index and testCount. Work over all courses runs one course per pool
+// task; the shards have no pool of their own while that happens, so nothing
+// nests. The ranking across courses is a k-way merge of every course's own
+// best-first list, never a re-sort of all students.
+//
+// Each course also persists on its own, next to its CSV: DIR/NAME.snap is
+// written by "save" in the course menu and DIR/NAME.snap.wal journals the
+// changes made since. A course starts from its snapshot once it has one (the
+// CSV only seeds it until the first save) and its journal is replayed on top.
+// The journal is opened the first time the course is, so there is one
+// flusher thread per course in use, not per course in DIR.
+
+struct Course
+{
+    std::string name;
+    std::string snapshotPath;        //DIR/NAME.snap
+    std::string journalPath;         //DIR/NAME.snap.wal
+    std::uint64_t journalBytes = 0;  //valid length found by the replay
+    Journal journal;                 //open once the course has been opened
+    Gradebook gb;
+};
+
+struct CourseCatalog
+{
+    std::vector<std::unique_ptr<Course>> courses; //sorted by name
+    ThreadPool* pool = nullptr;
+};
+
+const TableColumn COURSE_COLUMNS[7] = {{16, true}, {10, false}, {7, false}, {10, false}, {10, false}, {10, false}, {10, false}};
+const TableColumn CROSS_RANKING_COLUMNS[6] = {{7, true}, {16, true}, {14, true}, {20, true}, {10, false}, {8, false}};
+const int COURSE_WAVE = 64; //courses formatted before their reports are printed
+
+// Runs fn(c) for every course c, one pool task per course.
+void forEachCourse(const CourseCatalog &cat, const std::function<void(int)> &fn)
+{
+    int n = int(cat.courses.size());
+    if (!cat.pool || cat.pool->size() == 1 || n == 1)
+    {
+        for (int c=0; c<n; c++) fn(c);
+        return;
+    }
+    cat.pool->run(n, fn);
+}
+
+// Loads one course: its snapshot if it has been saved, else its CSV, then
+// the changes in its journal. False if the course is skipped.
+bool loadCourse(Course &course, const std::string &csvPath, bool verifySnapshot)
+{
+    Gradebook &gb = course.gb;
+    std::string error;
+    if (access(course.snapshotPath.c_str(), F_OK) == 0)
+    {
+        if (!openSnapshot(gb, course.snapshotPath.c_str(), verifySnapshot, error))
+        {
+            cout<<"  "<<course.snapshotPath<<" rejected: "<<error<<"\n";
+            return false;
+        }
+        cout<<"Opened "<<course.snapshotPath<<" ("<<gb.studentCount<<" students, "<<gb.testCount<<" assessments).\n";
+    }
+    else if (importCsv(gb, csvPath.c_str()) < 0) return false;
+    long long applied = 0;
+    if (!replayJournal(gb, course.journalPath.c_str(), course.journalBytes, applied, error))
+    {
+        cout<<"  "<<course.journalPath<<" rejected: "<<error<<"\n";
+        return false;
+    }
+    if (applied > 0) cout<<"Replayed "<<applied<<" change(s) from "<<course.journalPath<<".\n";
+    if (gb.testCount == 0)
+    {
+        cout<<"  "<<csvPath<<": no students, skipped\n";
+        return false;
+    }
+    return true;
+}
+
+// Loads every course of DIR/*.csv. Returns the number of courses.
+int loadCourses(CourseCatalog &cat, const char* dir, bool verifySnapshot)
+{
+    DIR* d = opendir(dir);
+    if (!d)
+    {
+        cout<<"Cannot open "<<dir<<"\n";
+        return -1;
+    }
+    std::vector<std::string> files;
+    while (dirent* e = readdir(d))
+    {
+        std::string file = e->d_name;
+        if (file.size() > 4 && file.compare(file.size() - 4, 4, ".csv") == 0) files.push_back(file);
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+
+    long long students = 0;
+    for (const std::string &file : files)
+    {
+        std::unique_ptr<Course> course(new Course);
+        course->name = file.substr(0, file.size() - 4);
+        course->snapshotPath = std::string(dir) + "/" + course->name + ".snap";
+        course->journalPath = course->snapshotPath + ".wal";
+        if (!loadCourse(*course, std::string(dir) + "/" + file, verifySnapshot)) continue;
+        students += course->gb.studentCount;
+        cat.courses.push_back(std::move(course));
+    }
+    cout<<"Loaded "<<cat.courses.size()<<" course(s) with "<<students<<" student(s) from "<<dir<<".\n";
+    return int(cat.courses.size());
+}
+
+int findCourse(const CourseCatalog &cat, const char* name)
+{
+    auto it = std::lower_bound(cat.courses.begin(), cat.courses.end(), name,
+        [](const std::unique_ptr<Course> &c, const char* n) { return c->name < n; });
+    return it != cat.courses.end() && (*it)->name == name ? int(it - cat.courses.begin()) : -1;
+}
+
+struct CourseSummary
+{
+    int students;
+    double classAvg, bestAvg, worstAvg, median, passRate;
+};
+
+CourseSummary summarizeCourse(const Gradebook &gb)
+{
+    ReadGuard guard(gb.shared.get());
+    ClassTotals t = readClassTotals(gb);
+    CourseSummary s{t.students, NO_AVERAGE, NO_AVERAGE, NO_AVERAGE, NO_AVERAGE, NO_AVERAGE};
+    if (t.graded == 0) return s; //nobody to average yet
+    std::vector<int> totals, partial, marks;
+    readHistograms(gb, totals, partial, marks);
+    double q[QUANTILE_COUNT];
+    averageQuantiles(totals, partial, gb.testCount, q);
+    s.classAvg = t.classAvg;
+    s.bestAvg = t.bestAvg;
+    s.worstAvg = t.worstAvg;
+    s.median = q[2];
+    s.passRate = double(t.passCount) / t.graded * 100.0;
+    return s;
+}
+
+// One line per course; the courses are summarized in parallel.
+void showCourseSummaries(const CourseCatalog &cat)
+{
+    OpTimer timer(STAT_COURSE_REPORTS);
+    std::vector<CourseSummary> sums(cat.courses.size());
+    forEachCourse(cat, [&](int c) { sums[c] = summarizeCourse(cat.courses[c]->gb); });
+
+    ReportWriter out;
+    out.text("\n-------------------------------- Course Summaries --------------------------------\n\n");
+    const char* heads[7] = {"Course", "Students", "Tests", "Average", "Median", "Highest", "Pass %"};
+    for (int i=0; i<7; i++) out.cell(heads[i], COURSE_COLUMNS[i]);
+    out.text("\n");
+    out.repeat('-', 16+10+7+10+10+10+10);
+    out.text("\n");
+    for (std::size_t c=0; c<sums.size(); c++)
+    {
+        out.cell(cat.courses[c]->name.c_str(), COURSE_COLUMNS[0]);
+        out.cellInt(sums[c].students, COURSE_COLUMNS[1]);
+        out.cellInt(cat.courses[c]->gb.testCount, COURSE_COLUMNS[2]);
+        out.cellAverage(sums[c].classAvg, COURSE_COLUMNS[3]);
+        out.cellAverage(sums[c].median, COURSE_COLUMNS[4]);
+        out.cellAverage(sums[c].bestAvg, COURSE_COLUMNS[5]);
+        out.cellAverage(sums[c].passRate, COURSE_COLUMNS[6]);
+        out.text("\n");
+    }
+    out.text("\n");    out.flush();
+    restoreTableStreamState();
+}
+
+// The full ranking of every course. Each course is ranked and formatted into
+// its own buffer on a pool thread; the buffers are printed in course order a
+// wave at a time, so memory holds COURSE_WAVE reports at most.
+void showCourseRankings(const CourseCatalog &cat)
+{
+    OpTimer timer(STAT_COURSE_REPORTS);
+    int n = int(cat.courses.size());
+    std::vector<std::string> reports(std::min(n, COURSE_WAVE));
+    for (int first=0; first<n; first+=COURSE_WAVE)
+    {
+        int count = std::min(COURSE_WAVE, n - first);
+        auto format = [&](int w)
+        {
+            const Course &course = *cat.courses[first + w];
+            const Gradebook &gb = course.gb;
+            ReadGuard guard(gb.shared.get());
+            std::vector<RankEntry> ranking = rankStudents(gb);
+            reports[w].clear();
+            ReportWriter out(reports[w]);
+            out.text("\n-------- ");
+            out.text(course.name.c_str());
+            out.text(": Performance Ranking --------\n\n");
+            printRankingHeader(out);
+            for (int rank=0; rank<int(ranking.size()); rank++) printRankingRow(out, gb, rank + 1, ranking[rank]);
+        };
+        if (!cat.pool || cat.pool->size() == 1 || count == 1) for (int w=0; w<count; w++) format(w);
+        else cat.pool->run(count, format);
+        for (int w=0; w<count; w++) cout.write(reports[w].data(), reports[w].size());
+    }
+    cout<<"\n";
+}
+
+struct CourseEntry
+{
+    double avg;
+    int course;
+    int row;
+};
+
+// True when a ranks ahead of b across courses: average, then id, then course.
+bool crossRanksAhead(const CourseCatalog &cat, const CourseEntry &a, const CourseEntry &b)
+{
+    if (a.avg != b.avg) return a.avg > b.avg;
+    int byId = compareIds(cat.courses[a.course]->gb, a.row, cat.courses[b.course]->gb, b.row);
+    if (byId != 0) return byId < 0;
+    return a.course < b.course;
+}
+
+// The k best students of all courses. Every course picks its own top k in
+// parallel (already in rank order), then a heap over the heads of those
+// lists pops the overall best k: O(courses * k) selection plus O(k log courses).
+std::vector<CourseEntry> topAcrossCourses(const CourseCatalog &cat, int k)
+{
+    OpTimer timer(STAT_COURSE_MERGE);
+    int n = int(cat.courses.size());
+    std::vector<std::vector<RankEntry>> lists(n);
+    forEachCourse(cat, [&](int c)
+    {
+        const Gradebook &gb = cat.courses[c]->gb;
+        ReadGuard guard(gb.shared.get());
+        lists[c] = topStudents(gb, k, true);
+    });
+
+    auto behind = [&cat](const CourseEntry &a, const CourseEntry &b) { return crossRanksAhead(cat, b, a); };
+    std::vector<CourseEntry> heap;
+    std::vector<std::size_t> next(n, 1);
+    for (int c=0; c<n; c++)
+    {
+        if (!lists[c].empty()) heap.push_back({lists[c][0].avg, c, lists[c][0].row});
+    }
+    std::make_heap(heap.begin(), heap.end(), behind);
+
+    std::vector<CourseEntry> merged;
+    while (int(merged.size()) < k && !heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), behind);
+        CourseEntry e = heap.back();
+        heap.pop_back();
+        merged.push_back(e);
+        const std::vector<RankEntry> &list = lists[e.course];
+        if (next[e.course] < list.size())
+        {
+            const RankEntry &r = list[next[e.course]++];
+            heap.push_back({r.avg, e.course, r.row});
+            std::push_heap(heap.begin(), heap.end(), behind);
+        }
+    }
+    return merged;
+}
+
+void showTopAcrossCourses(const CourseCatalog &cat)
+{
+    long long students = 0;
+    for (const std::unique_ptr<Course> &course : cat.courses) students += course->gb.studentCount;
+    if (students == 0)
+    {
+        cout<<"No Students yet.\n";
+        return;
+    }
+    int k = readIntRange("How many students: ", 1, int(std::min<long long>(students, INT_MAX)));
+    if (inputAborted()) return;
+    std::vector<CourseEntry> top = topAcrossCourses(cat, k);
+
+    ReportWriter out;
+    out.text("\n-------- Top Students Across All Courses --------\n\n");
+    const char* heads[6] = {"#", "Course", "ID", "Name", "Average", "Grade"};
+    for (int i=0; i<6; i++) out.cell(heads[i], CROSS_RANKING_COLUMNS[i]);
+    out.text("\n");
+    out.repeat('-', 7+16+14+20+10+8);
+    out.text("\n");
+    for (int i=0; i<int(top.size()); i++)
+    {
+        const CourseEntry &e = top[i];
+        const Course &course = *cat.courses[e.course];
+        out.cellInt(i + 1, CROSS_RANKING_COLUMNS[0]);
+        out.cell(course.name.c_str(), CROSS_RANKING_COLUMNS[1]);
+        out.cell(studentId(course.gb, e.row), CROSS_RANKING_COLUMNS[2]);
+        out.cell(studentName(course.gb, e.row), CROSS_RANKING_COLUMNS[3]);
+        out.cellFixed2(e.avg, CROSS_RANKING_COLUMNS[4]);
+        out.cell(letterGrade(e.avg), CROSS_RANKING_COLUMNS[5]);
+        out.text("\n");
+    }
+    out.text("\n");
+    out.flush();
+    restoreTableStreamState();
+}
+
+// Runs the single-course menu on one course; it borrows the pool meanwhile.
+// The course's journal is opened here the first time, with the --fsync
+// settings given on the command line (held by settings).
+void openCourse(CourseCatalog &cat, const Journal &settings)
+{
+    char name[NAME_LEN];
+    readName("Course name: ", name, NAME_LEN, 0);
+    if (inputAborted()) return;
+    int c = findCourse(cat, name);
+    if (c < 0)
+    {
+        commandError()<<"Course not found!\n";
+        return;
+    }
+    Course &course = *cat.courses[c];
+    Gradebook &gb = course.gb;
+    if (!gb.journal)
+    {
+        course.journal.policy = settings.policy;
+        course.journal.intervalMs = settings.intervalMs;
+        std::string error;
+        if (!openJournal(course.journal, course.journalPath.c_str(), gb.testCount, course.journalBytes, error))
+        {
+            commandError()<<"Journal "<<course.journalPath<<": "<<error<<"\n";
+            return;
+        }
+        gb.journal = &course.journal;
+    }
+    cout<<"Course "<<course.name<<": "<<gb.studentCount<<" students, "<<gb.testCount<<" assessments.\n";
+    gb.pool = cat.pool;
+    runMenu(gb, course.journal, course.snapshotPath.c_str(), true);
+    gb.pool = nullptr;
+}
+
+void runCourseMenu(CourseCatalog &cat, const Journal &settings)
+{
+    while (true)
+    {
+        if (!batchInput)
+        {
+            cout << "\nCourses ("<<cat.courses.size()<<")\n";
+            cout << " 1) Summary of every course\n";
+            cout << " 2) Performance ranking of every course\n";
+            cout << " 3) Top students across all courses\n";
+            cout << " 4) Open a course\n";
+            cout << " 0) Exit the program\n";
+        }
+        else batchNextCommand(*batchInput);
+
+        int choice = readIntRange("Choice: ", 0, 4);
+        if (inputEnded()) return;
+        if (inputAborted()) continue;
+        if (choice==0)
+        {
+            cout<<"\nGood Bay!\n";
+            return;
+        }
+        if (batchInput) batchInput->inCommand = true;
+        switch (choice)
+        {
+            case 1: showCourseSummaries(cat); break;
+            case 2: showCourseRankings(cat); break;
+            case 3: showTopAcrossCourses(cat); break;
+            case 4: openCourse(cat, settings); break;
+        }
+    }
+}
+
+// --bench-lookup N: time findStudentById (hash index) against the linear scan
+// over N synthetic ids of the form ets0000001.
+int benchLookup(int n)
+{
+    using Clock = std::chrono::steady_clock;
+    if (n < 1 || n > 9999999)
+    {
+        cout<<"Student count must be between [1, 9999999]\n";
+        return 1;
+    }
+    Gradebook gb;
+    gb.testCount = 1;
+    char id[ID_LEN];
+    const Mark row[1] = {0};
+    auto t0 = Clock::now();
+    for (int i=0; i<n; i++)
+    {
+        std::snprintf(id, ID_LEN, "ets%07d", i+1);
+        appendStudent(gb, id, "Student", row);
+    }
+    auto t1 = Clock::now();
+
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> pick(0, n-1);
+    const int hashProbes = 1000000;
+    const int scanProbes = n > 100000 ? 200 : 2000; //the scan is O(n), keep it bounded
+    std::vector<int> probes(hashProbes);
+    for (int &p : probes) p = pick(rng);
+    //queries arrive as their own strings, not as pointers into the id column
+    std::vector<char> queries(std::size_t(hashProbes) * ID_LEN);
+    for (int i=0; i<hashProbes; i++) std::memcpy(&queries[std::size_t(i) * ID_LEN], studentId(gb, probes[i]), ID_LEN);
+
+    long long check = 0;
+    auto t2 = Clock::now();
+    for (int i=0; i<hashProbes; i++) check += findStudentById(gb, &queries[std::size_t(i) * ID_LEN]);
+    auto t3 = Clock::now();
+    for (int i=0; i<scanProbes; i++) check -= findStudentByIdLinear(gb, &queries[std::size_t(i) * ID_LEN]);
+    auto t4 = Clock::now();
+
+    double buildMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    double hashNs = std::chrono::duration<double, std::nano>(t3 - t2).count() / hashProbes;
+    double scanNs = std::chrono::duration<double, std::nano>(t4 - t3).count() / scanProbes;
+
+    cout<<"Students         : "<<n<<"\n";
+    cout<<std::fixed<<std::setprecision(2);
+    cout<<"Load + index     : "<<buildMs<<" ms\n";
+    cout<<"Hash lookup      : "<<hashNs<<" ns/lookup ("<<hashProbes<<" probes)\n";
+    cout<<"Linear lookup    : "<<scanNs<<" ns/lookup ("<<scanProbes<<" probes)\n";
+    cout<<"Speedup          : "<<(hashNs > 0 ? scanNs / hashNs : 0.0)<<"x\n";
+    if (check == 42) cout<<"\n"; //keeps the loops from being optimized away
+    return 0;
+}
+
+// --bench-columns N: one column of N random marks through each column kernel.
+int benchColumns(int n)
+{
+    using Clock = std::chrono::steady_clock;
+    if (n < 1 || n > 200000000)
+    {
+        cout<<"Mark count must be between [1, 200000000]\n";
+        return 1;
+    }
+    std::vector<std::uint8_t> col(n);
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> mark(0, 100);
+    for (std::uint8_t &v : col) v = std::uint8_t(mark(rng));
+
+    struct { const char* name; ColumnKernel kernel; } kernels[] = {
+        {"scalar", columnStatsScalar},
+#ifdef GB_X86_SIMD
+        {"SSE4.1", __builtin_cpu_supports("sse4.1") ? columnStatsSse : nullptr},
+        {"AVX2", __builtin_cpu_supports("avx2") ? columnStatsAvx2 : nullptr},
+#endif
+    };
+    const int reps = std::max(1, 50000000 / n);
+    ColumnStats ref = columnStatsScalar(col.data(), n);
+    double scalarMs = 0;
+    cout<<"Marks            : "<<n<<" x "<<reps<<" passes\n";
+    cout<<std::fixed<<std::setprecision(2);
+    for (auto &k : kernels)
+    {
+        if (!k.kernel)
+        {
+            cout<<std::left<<std::setw(17)<<k.name<<": not supported on this CPU\n";
+            continue;
+        }
+        ColumnStats st;
+        auto t0 = Clock::now();
+        for (int r=0; r<reps; r++) st = k.kernel(col.data(), n);
+        auto t1 = Clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / reps;
+        if (k.kernel == columnStatsScalar) scalarMs = ms;
+        bool same = st.sum == ref.sum && st.sumSquares == ref.sumSquares && st.low == ref.low && st.high == ref.high;
+        cout<<std::left<<std::setw(17)<<k.name<<": "<<ms<<" ms/pass, "<<(ms > 0 ? n / ms / 1e6 : 0.0)
+            <<" M marks/ms, "<<(ms > 0 ? scalarMs / ms : 0.0)<<"x scalar"<<(same ? "" : "  RESULT MISMATCH")<<"\n";
+    }
+    cout<<"Menu kernel      : "<<columnKernelName()<<"\n";
+    return 0;
+}
+
+// ---------------- benchmark suite (--bench-suite N [TESTS [SEED]]) ----------------
+// Builds a seeded synthetic class of N students and times every menu
+// operation one call at a time. The prompt-driven operations run the real
+// menu functions: their input comes from a prepared script on cin and all
+// output (prompts included) goes to a counting sink. Results are printed as
+// one JSON object; project.cpp prints the same fields, so runs of the two
+// programs can be compared directly.
+
+const char* const SYNTH_FIRST[16] = {"Abel", "Hana", "Dawit", "Meron", "Yonas", "Sara", "Kebede", "Lidya",
+                                     "Samuel", "Ruth", "Elias", "Betty", "Nahom", "Selam", "Robel", "Mahlet"};
+const char* const SYNTH_LAST[16] = {"Tesfaye", "Girma", "Bekele", "Haile", "Alemu", "Desta", "Worku", "Tadesse",
+                                    "Mengistu", "Abebe", "Kassa", "Negash", "Wolde", "Ayele", "Gebre", "Mulugeta"};
+
+std::uint64_t splitmix64(std::uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Student k (0 <= k < 10^7) of the synthetic class for seed. The id number is
+// k times a multiplier coprime to 10^7, so ids are distinct but not in row
+// order. Every student has an ability around which their marks scatter.
+void syntheticStudent(std::uint64_t seed, long long k, int tests, char* id, char* name, Mark* row)
+{
+    const long long space = 10000000;
+    long long mult = static_cast<long long>(seed % space) | 1;
+    if (mult % 5 == 0) mult += 2;
+    long long offset = static_cast<long long>((seed >> 24) % space);
+    long long number = (k * mult + offset) % space;
+    std::memcpy(id, "ets", 3);
+    for (int d=9; d>=3; d--, number/=10) id[d] = char('0' + number % 10);
+    id[10] = '\0';
+
+    std::uint64_t r = splitmix64(seed ^ static_cast<std::uint64_t>(k) * 0xD1B54A32D192ED03ULL);
+    std::snprintf(name, NAME_LEN, "%s %s", SYNTH_FIRST[r & 15], SYNTH_LAST[(r >> 4) & 15]);
+    int ability = 30 + int((r >> 8) % 66);
+    for (int t=0; t<tests; t++)
+    {
+        r = splitmix64(r);
+        int mark = ability + int(r % 31) - 15;
+        row[t] = Mark(mark < 0 ? 0 : mark > 100 ? 100 : mark);
+    }
+}
+
+// Swallows whatever is written to it and counts the bytes.
+struct NullSink : std::streambuf
+{
+    long long bytes = 0;
+    int overflow(int c) override { ++bytes; return c == EOF ? 0 : c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { bytes += n; return n; }
+};
+
+struct BenchResult
+{
+    const char* op;
+    std::vector<long long> ns; //one latency per call
+    long long sinkBytes;
+};
+
+// Times fn(i) for i in [0, ops), one call at a time.
+template <typename Fn>
+BenchResult timeOps(const char* op, int ops, NullSink &sink, Fn fn)
+{
+    using Clock = std::chrono::steady_clock;
+    BenchResult res{op, std::vector<long long>(ops), 0};
+    long long before = sink.bytes;
+    for (int i=0; i<ops; i++)
+    {
+        auto t0 = Clock::now();
+        fn(i);
+        auto t1 = Clock::now();
+        res.ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    }
+    res.sinkBytes = sink.bytes - before;
+    return res;
+}
+
+// Nearest-rank percentile of v (sorted in place).
+long long percentile(std::vector<long long> &v, int p)
+{
+    if (v.empty()) return 0;
+    std::size_t rank = (v.size() * p + 99) / 100;
+    std::size_t at = rank > 0 ? rank - 1 : 0;
+    std::nth_element(v.begin(), v.begin() + at, v.end());
+    return v[at];
+}
+
+int benchSuite(int n, int tests, std::uint64_t seed, int threads)
+{
+    if (n < 1 || n > 10000000 || tests < 1 || tests > MAX_TESTS)
+    {
+        cout<<"Students must be between [1, 10000000] and tests between [1, "<<MAX_TESTS<<"]\n";
+        return 1;
+    }
+    ThreadPool pool(threads);
+    Gradebook gb;
+    gb.pool = &pool;
+    std::mt19937_64 rng(seed);
+    const int pointOps = 100000;
+    const int addOps = std::min(n, pointOps);
+    const int wholeReps = std::max(3, std::min(200, 2000000 / n));
+
+    NullSink sink;
+    std::streambuf* realOut = cout.rdbuf(&sink);
+    std::streambuf* realIn = cin.rdbuf();
+    std::istringstream script;
+    auto feed = [&](const std::string &text) { script.clear(); script.str(text); cin.rdbuf(script.rdbuf()); };
+    std::vector<BenchResult> results;
+
+    //load: the generator appending straight into the columns
+    gb.testCount = tests;
+    reserveStudents(gb, n + addOps);
+    {
+        char id[ID_LEN];
+        char name[NAME_LEN];
+        std::vector<Mark> row(tests);
+        results.push_back(timeOps("load", n, sink, [&](int k)
+        {
+            syntheticStudent(seed, k, tests, id, name, row.data());
+            appendStudent(gb, id, name, row.data());
+        }));
+    }
+
+    //add: the addStudent prompts, with ids outside the generator's digits-only range
+    std::string text;
+    char buf[64];
+    for (int i=0; i<addOps; i++)
+    {
+        std::snprintf(buf, sizeof(buf), "etsa%06d\nBench Student\n", i);
+        text += buf;
+        for (int t=0; t<tests; t++) text += std::to_string(rng() % 101) + "\n";
+    }
+    feed(text);
+    results.push_back(timeOps("add", addOps, sink, [&](int) { addStudent(gb); }));
+
+    std::vector<int> picks(pointOps);
+    for (int &p : picks) p = int(rng() % std::uint64_t(gb.studentCount));
+    long long found = 0;
+    results.push_back(timeOps("lookup", pointOps, sink, [&](int i)
+    {
+        found += findStudentById(gb, studentId(gb, picks[i]));
+    }));
+
+    text.clear();
+    for (int i=0; i<pointOps; i++)
+    {
+        std::snprintf(buf, sizeof(buf), "%s\n%d\n%d\n", studentId(gb, picks[i]), int(rng() % tests) + 1, int(rng() % 101));
+        text += buf;
+    }
+    feed(text);
+    results.push_back(timeOps("update", pointOps, sink, [&](int) { updateMarks(gb); }));
+
+    text.clear();
+    for (int i=0; i<pointOps; i++) (text += studentId(gb, picks[pointOps - 1 - i])) += "\n";
+    feed(text);
+    results.push_back(timeOps("report", pointOps, sink, [&](int) { printStudentReport(gb); }));
+
+    results.push_back(timeOps("list", wholeReps, sink, [&](int) { listStudents(gb, false); }));
+    results.push_back(timeOps("summary", wholeReps, sink, [&](int) { classSummaryAndRanging(gb); }));
+
+    text.clear();
+    for (int i=0; i<wholeReps; i++) text += "1\n10\n";
+    feed(text);
+    results.push_back(timeOps("top10", wholeReps, sink, [&](int) { showTopStudents(gb); }));
+    results.push_back(timeOps("stats", wholeReps, sink, [&](int) { showAssessmentStats(gb); }));
+
+    cin.rdbuf(realIn);
+    cout.rdbuf(realOut);
+    cout<<"{\n  \"program\": \"cppProject\",\n  \"marks\": \"uint8\",\n"
+        <<"  \"students\": "<<n<<",\n  \"tests\": "<<tests<<",\n  \"seed\": "<<seed
+        <<",\n  \"threads\": "<<pool.size()<<",\n  \"results\": [\n";
+    for (std::size_t r=0; r<results.size(); r++)
+    {
+        BenchResult &res = results[r];
+        long long totalNs = 0;
+        for (long long v : res.ns) totalNs += v;
+        double totalMs = totalNs / 1e6;
+        double perSec = totalNs > 0 ? res.ns.size() / (totalNs / 1e9) : 0.0;
+        long long p50 = percentile(res.ns, 50), p99 = percentile(res.ns, 99);
+        char line[320];
+        std::snprintf(line, sizeof(line),
+            "    {\"op\": \"%s\", \"ops\": %zu, \"total_ms\": %.3f, \"ops_per_sec\": %.1f, "
+            "\"p50_ns\": %lld, \"p99_ns\": %lld, \"sink_bytes\": %lld}%s\n",
+            res.op, res.ns.size(), totalMs, perSec, p50, p99, res.sinkBytes, r + 1 < results.size() ? "," : "");
+        cout<<line;
+    }
+    cout<<"  ]\n}\n";
+    if (found == 42) cout<<"\n"; //keeps the lookups from being optimized away
+    return 0;
+}
+
+// ---------------- reader stress test (--stress-readers [READERS [SECONDS [STUDENTS]]]) ----------------
+// One writer changes marks as fast as it can and appends a student every
+// 1024 changes (so columns regrow and the index rehashes under the readers),
+// while 1, 2, 4 .. READERS threads read students through the shared-read
+// path. Every copy is checked against itself: the marks must add up to the
+// total and match the low and high mark stored with them, and the class
+// totals must be mutually consistent. The same rows are also copied without
+// the seqlock as a control, to show the check does catch torn reads.
+
+struct ReaderTally
+{
+    long long reads = 0;
+    long long retries = 0;
+    long long torn = 0;
+    long long uncheckedTorn = 0;
+};
+
+bool rowConsistent(const Mark* marks, const RowAggregate &ra, int tests)
+{
+    RowAggregate want = rowAggregate(marks, tests);
+    return want.total == ra.total && want.low == ra.low && want.high == ra.high && want.graded == ra.graded;
+}
+
+void stressReader(const Gradebook &gb, int seed, const std::atomic<bool> &stop, ReaderTally &tally)
+{
+    std::mt19937 rng(seed);
+    std::vector<Mark> marks(gb.testCount), raw(gb.testCount);
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        ReadGuard guard(gb.shared.get());
+        for (int i=0; i<1024; i++)
+        {
+            int row = int(rng() % unsigned(visibleStudents(gb)));
+            RowAggregate ra;
+            tally.retries += readStudent(gb, row, marks.data(), ra);
+            if (!rowConsistent(marks.data(), ra, gb.testCount)) ++tally.torn;
+
+            //the control: the same copy with no sequence check
+            const ReadView* v = gb.shared->view.load();
+            std::memcpy(raw.data(), v->marks + std::size_t(row) * gb.testCount, sizeof(Mark) * gb.testCount);
+            RowAggregate rawAgg = v->rows[row];
+            if (!rowConsistent(raw.data(), rawAgg, gb.testCount)) ++tally.uncheckedTorn;
+
+            if ((i & 15) == 0 && findStudentById(gb, studentId(gb, row)) != row) ++tally.torn;
+            if ((i & 255) == 0)
+            {
+                ClassTotals t = readClassTotals(gb);
+                if (t.worstAvg > t.bestAvg || t.passCount > t.graded || t.graded > t.students
+                    || t.classAvg < t.worstAvg - 1e-9 || t.classAvg > t.bestAvg + 1e-9) ++tally.torn;
+            }
+        }
+        tally.reads += 1024;
+    }
+}
+
+int stressReaders(int maxReaders, int seconds, int n)
+{
+    if (maxReaders < 1 || maxReaders > 256 || seconds < 1 || n < 1 || n > 5000000)
+    {
+        cout<<"Readers must be between [1, 256], seconds at least 1 and students between [1, 5000000]\n";
+        return 1;
+    }
+    const std::uint64_t seed = 2024;
+    const int tests = 4;
+    Gradebook gb;
+    gb.testCount = tests;
+    char id[ID_LEN];
+    char name[NAME_LEN];
+    std::vector<Mark> row(tests);
+    for (int k=0; k<n; k++)
+    {
+        syntheticStudent(seed, k, tests, id, name, row.data());
+        appendStudent(gb, id, name, row.data());
+    }
+    enableSharedReads(gb);
 
-    char ids[MAX_STUDENT][ID_LEN]{};
-    char names[MAX_STUDENT][NAME_LEN]{};
-    double marks[MAX_STUDENT][MAX_TESTS]{};
-    int studentCount = 0;
-    
-    while (true)
+    cout<<"Stress test: "<<n<<" students, "<<seconds<<" s per round, one writer ("
+        <<std::thread::hardware_concurrency()<<" hardware threads)\n";
+    cout<<std::right<<std::setw(8)<<"Readers"<<std::setw(14)<<"Reads/s"<<std::setw(14)<<"Per reader"
+        <<std::setw(12)<<"Writes/s"<<std::setw(10)<<"Appends"<<std::setw(10)<<"Retries"
+        <<std::setw(8)<<"Torn"<<std::setw(16)<<"Control torn"<<"\n";
+    long long next = n;
+    long long totalTorn = 0;
+    for (int readers=1; ; readers = std::min(readers * 2, maxReaders))
     {
+        std::atomic<bool> stop{false};
+        std::vector<ReaderTally> tallies(readers);
+        std::vector<std::thread> threads;
+        long long writes = 0, appends = 0;
+        std::thread writer([&]
+        {
+            std::mt19937 rng(7);
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                setMark(gb, int(rng() % unsigned(gb.studentCount)), int(rng() % tests), int(rng() % 101));
+                if ((++writes & 1023) == 0 && next < 10000000)
+                {
+                    syntheticStudent(seed, next++, tests, id, name, row.data());
+                    appendStudent(gb, id, name, row.data());
+                    ++appends;
+                }
+            }
+        });
+        for (int r=0; r<readers; r++)
+        {
+            threads.emplace_back([&, r] { stressReader(gb, 100 + r, stop, tallies[r]); });
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        stop = true;
+        writer.join();
+        for (std::thread &t : threads) t.join();
+
+        ReaderTally sum;
+        for (const ReaderTally &t : tallies)
+        {
+            sum.reads += t.reads;
+            sum.retries += t.retries;
+            sum.torn += t.torn;
+            sum.uncheckedTorn += t.uncheckedTorn;
+        }
+        totalTorn += sum.torn;
+        cout<<std::fixed<<std::setprecision(0)
+            <<std::setw(8)<<readers<<std::setw(14)<<double(sum.reads) / seconds
+            <<std::setw(14)<<double(sum.reads) / seconds / readers<<std::setw(12)<<double(writes) / seconds
+            <<std::setw(10)<<appends<<std::setw(10)<<sum.retries
+            <<std::setw(8)<<sum.torn<<std::setw(16)<<sum.uncheckedTorn<<"\n"<<std::flush;
+        if (readers == maxReaders) break;
+    }
+    cout<<(totalTorn == 0 ? "No torn reads.\n" : "TORN READS FOUND.\n");
+    return totalTorn == 0 ? 0 : 1;
+}
 
-    cout << "\nMenu\n";
-    cout << " 1) Add a student record\n";
-    cout << " 2) Update a student's assessment score\n";
-    cout << " 3) Generate an individual student report\n";
-    cout << " 4) Generate class summary and performance ranking\n";
-    cout << " 5) Display all student records\n";
-    cout << " 0) Exit the program\n";
+// ---------------- gradebook server (--serve socket [--serve-tcp port]) ----------------
+// Keeps the class in memory and answers many clients at once over a Unix
+// domain socket and, optionally, 127.0.0.1:port. Each of --serve-threads
+// threads runs its own epoll loop over the connections it accepted. With one
+// loop requests never race. With more, shared reads are turned on (see
+// "concurrent readers"): GET, LIST, SUMMARY and TOP read through the seqlocks
+// without waiting (TOP picks from a fresh scan of the row aggregates and never
+// touches the rank index), while SET and ADD take turns on one writer lock.
+// Requests are text lines and can be pipelined; answers on a connection come
+// back in request order:
+//   ADD id m1 .. mN name    SET id test mark    GET id    LIST [offset [count]]
+//   SUMMARY                 TOP k [BOTTOM]      STATS
+// An answer is "OK n" followed by n lines, or a single "ERR reason" line.
+// Ids, names and marks are checked with the same rules as the prompts.
 
-        
-        int choice = readIntRange("Choice: ", 0, 5);
-        if (choice==0)
+const std::size_t SERVER_MAX_LINE = 4096;
+const std::size_t SERVER_OUT_HIGH = 4 << 20; //stop answering a client until its backlog drains below this
+
+volatile sig_atomic_t serverStopping = 0;
+
+void stopServer(int) { serverStopping = 1; }
+
+struct ServerConn
+{
+    int fd = -1;
+    std::string in;
+    std::string out;
+    std::size_t outPos = 0;  //bytes of out already sent
+    bool peerClosed = false;
+    unsigned interest = 0;   //epoll events currently registered
+};
+
+// Splits a line into at most maxTokens blank separated tokens.
+int splitTokens(const char* line, const char* end, const char** tok, const char** tokEnd, int maxTokens)
+{
+    int n = 0;
+    const char* p = line;
+    while (n < maxTokens)
+    {
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        if (p == end) break;
+        tok[n] = p;
+        while (p < end && *p != ' ' && *p != '\t') ++p;
+        tokEnd[n++] = p;
+    }
+    return n;
+}
+
+bool parseServerInt(const char* b, const char* e, int minV, int maxV, int &v)
+{
+    auto res = std::from_chars(b, e, v);
+    return res.ec == std::errc() && res.ptr == e && v >= minV && v <= maxV;
+}
+
+// Copies and normalizes an id token; false unless readId would accept it.
+bool parseServerId(const char* b, const char* e, char* id)
+{
+    if (e - b >= ID_LEN) return false;
+    std::memcpy(id, b, e - b);
+    id[e - b] = '\0';
+    return normalizeId(id);
+}
+
+void appendRankLine(std::string &out, const Gradebook &gb, int rank, const RankEntry &e)
+{
+    out += std::to_string(rank);
+    out += '\t';
+    out += studentId(gb, e.row);
+    out += '\t';
+    out += studentName(gb, e.row);
+    out += '\t';
+    appendAverage(out, e.avg);
+    out += '\t';
+    out += letterGrade(e.avg);
+    out += '\n';
+}
+
+// Holds writer, if there is one; requests that change the class take it when
+// several loops share the class.
+std::unique_lock<std::mutex> lockWriter(std::mutex* writer)
+{
+    return writer ? std::unique_lock<std::mutex>(*writer) : std::unique_lock<std::mutex>();
+}
+
+// Answers one request line (without its newline) into out.
+void serveRequest(Gradebook &gb, std::mutex* writer, const char* line, std::size_t len, std::string &out)
+{
+    OpTimer timer(STAT_SERVER_REQUEST);
+    ReadGuard guard(gb.shared.get());
+    const char* end = line + len;
+    if (len > 0 && end[-1] == '\r') --end;
+    const char* tok[MAX_TESTS + 4];
+    const char* tokEnd[MAX_TESTS + 4];
+    int n = splitTokens(line, end, tok, tokEnd, 3 + gb.testCount);
+    auto is = [&](const char* word) { return n > 0 && std::size_t(tokEnd[0] - tok[0]) == std::strlen(word) && std::strncmp(tok[0], word, tokEnd[0] - tok[0]) == 0; };
+    char id[ID_LEN];
+
+    if (is("GET") && n == 2)
+    {
+        int idx = parseServerId(tok[1], tokEnd[1], id) ? findStudentById(gb, id) : -1;
+        if (idx < 0) { out += "ERR no such student\n"; return; }
+        Mark row[MAX_TESTS];
+        RowAggregate ra;
+        readStudent(gb, idx, row, ra);
+        double avg = rowAverage(ra);
+        out += "OK 1\n";
+        out += studentId(gb, idx);
+        out += '\t';
+        out += studentName(gb, idx);
+        out += '\t';
+        for (int t=0; t<gb.testCount; t++) (out += markText(row[t])) += (t + 1 == gb.testCount ? "\t" : ",");
+        (out += std::to_string((long long)ra.total)) += '\t';
+        if (ra.graded == 0) out += "-\t-\t";
+        else
         {
-            cout<<"\nGood Bay!\n";
+            (out += std::to_string(ra.low)) += '\t';
+            (out += std::to_string(ra.high)) += '\t';
+        }
+        appendAverage(out, avg);
+        out += '\t';
+        out += letterGrade(avg);
+        (out += '\t') += passStatus(avg);
+        out += '\n';
+    }
+    else if (is("SET") && n == 4)
+    {
+        std::unique_lock<std::mutex> held = lockWriter(writer);
+        int test, mark;
+        int idx = parseServerId(tok[1], tokEnd[1], id) ? findStudentById(gb, id) : -1;
+        if (idx < 0) out += "ERR no such student\n";
+        else if (!parseServerInt(tok[2], tokEnd[2], 1, gb.testCount, test)) out += "ERR test must be between [1, " + std::to_string(gb.testCount) + "]\n";
+        else if (!parseServerInt(tok[3], tokEnd[3], 0, 100, mark)) out += "ERR mark must be between [0, 100]\n";
+        else
+        {
+            setMark(gb, idx, test - 1, mark);
+            out += "OK 0\n";
+        }
+    }
+    else if (is("ADD") && n == 3 + gb.testCount)
+    {
+        std::unique_lock<std::mutex> held = lockWriter(writer);
+        std::vector<Mark> row(gb.testCount);
+        int bad = -1;
+        for (int t=0; t<gb.testCount && bad < 0; t++)
+        {
+            int mark;
+            if (parseServerInt(tok[2 + t], tokEnd[2 + t], 0, 100, mark)) row[t] = Mark(mark);
+            else bad = t;
+        }
+        //the name is the rest of the line, so it may contain spaces like readName allows
+        const char* nameBegin = tok[2 + gb.testCount];
+        const char* nameEnd = end;
+        while (nameEnd > nameBegin && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t')) --nameEnd;
+        if (!parseServerId(tok[1], tokEnd[1], id)) out += "ERR ID must start with ets/ETS and include more characters after it\n";
+        else if (findStudentById(gb, id) >= 0) out += "ERR student id already exists\n";
+        else if (bad >= 0) out += "ERR mark " + std::to_string(bad + 1) + " must be between [0, 100]\n";
+        else if (nameEnd - nameBegin >= NAME_LEN) out += "ERR name is longer than " + std::to_string(NAME_LEN - 1) + " characters\n";
+        else
+        {
+            char name[NAME_LEN];
+            std::memcpy(name, nameBegin, nameEnd - nameBegin);
+            name[nameEnd - nameBegin] = '\0';
+            appendStudent(gb, id, name, row.data());
+            out += "OK 0\n";
+        }
+    }
+    else if (is("LIST") && n <= 3)
+    {
+        int students = visibleStudents(gb);
+        int offset = 0, count = students;
+        if ((n >= 2 && !parseServerInt(tok[1], tokEnd[1], 0, INT_MAX, offset))
+            || (n == 3 && !parseServerInt(tok[2], tokEnd[2], 0, INT_MAX, count)))
+        {
+            out += "ERR usage: LIST [offset [count]]\n";
+            return;
+        }
+        int first = std::min(offset, students);
+        int last = first + std::min(count, students - first);
+        out += "OK " + std::to_string(last - first) + "\n";
+        for (int i=first; i<last; i++)
+        {
+            double avg = rowAverage(readAggregate(gb, i));
+            out += studentId(gb, i);
+            out += '\t';
+            out += studentName(gb, i);
+            out += '\t';
+            appendAverage(out, avg);
+            out += '\t';
+            out += letterGrade(avg);
+            out += '\n';
+        }
+    }
+    else if (is("SUMMARY") && n == 1)
+    {
+        ClassTotals totals = readClassTotals(gb);
+        int graded = totals.graded;
+        out += "OK 1\nstudents=" + std::to_string(totals.students) + " tests=" + std::to_string(gb.testCount);
+        out += " class_avg=";
+        appendAverage(out, totals.classAvg);
+        out += " best_avg=";
+        appendAverage(out, totals.bestAvg);
+        out += " worst_avg=";
+        appendAverage(out, totals.worstAvg);
+        out += " pass_rate=";
+        appendAverage(out, graded ? double(totals.passCount) / graded * 100.0 : NO_AVERAGE);
+        out += '\n';
+    }
+    else if (is("TOP") && (n == 2 || n == 3))
+    {
+        int k;
+        bool best = n == 2;
+        if (n == 3 && !(tokEnd[2] - tok[2] == 6 && std::strncmp(tok[2], "BOTTOM", 6) == 0)) k = -1;
+        else if (!parseServerInt(tok[1], tokEnd[1], 1, INT_MAX, k)) k = -1;
+        if (k < 0)
+        {
+            out += "ERR usage: TOP k [BOTTOM]\n";
+            return;
+        }
+        int ranked = 0;
+        std::vector<RankEntry> picked = topStudents(gb, k, best, &ranked);
+        out += "OK " + std::to_string(picked.size()) + "\n";
+        for (std::size_t i=0; i<picked.size(); i++)
+        {
+            appendRankLine(out, gb, best ? int(i) + 1 : ranked - int(i), picked[i]);
+        }
+    }
+    else if (is("STATS") && n == 1)
+    {
+        std::ostringstream table;
+        writeOpStats(table);
+        std::string text = table.str();
+        out += "OK " + std::to_string(std::count(text.begin(), text.end(), '\n')) + "\n";
+        out += text;
+    }
+    else if (n == 0) out += "ERR empty request\n";
+    else out += "ERR unknown request or wrong number of fields\n";
+}
+
+int listenUnix(const char* path)
+{
+    sockaddr_un addr{};
+    if (std::strlen(path) >= sizeof(addr.sun_path)) return -1;
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    //only a socket left behind by an earlier run is removed; any other file
+    //(or a symlink, which lstat does not follow) is left alone and refused
+    struct stat st;
+    if (lstat(path, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            close(fd);
+            errno = EEXIST;
+            return -1;
+        }
+        unlink(path);
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int listenLoopback(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// What the --serve-threads loops share.
+struct ServerShared
+{
+    Gradebook &gb;
+    int listeners[2];
+    int loops;
+    std::mutex writer;                  //used only with more than one loop
+    std::atomic<long long> served{0};   //connections accepted
+
+    explicit ServerShared(Gradebook &gb) : gb(gb), listeners{-1, -1}, loops(1) {}
+};
+
+// Answers the complete lines waiting in c.in, writes what the socket takes
+// and re-registers for the events c now needs. False once c is finished.
+bool pumpConnection(int epfd, ServerConn &c, ServerShared &server)
+{
+    std::mutex* writer = server.loops > 1 ? &server.writer : nullptr;
+    std::size_t pos = 0;
+    while (c.out.size() - c.outPos < SERVER_OUT_HIGH)
+    {
+        const char* nl = static_cast<const char*>(std::memchr(c.in.data() + pos, '\n', c.in.size() - pos));
+        if (!nl)
+        {
+            if (c.in.size() - pos > SERVER_MAX_LINE)
+            {
+                c.out += "ERR request line too long\n";
+                c.peerClosed = true; //answer, then hang up
+                pos = c.in.size();
+            }
             break;
         }
-        switch (choice)
+        serveRequest(server.gb, writer, c.in.data() + pos, nl - (c.in.data() + pos), c.out);
+        pos = nl - c.in.data() + 1;
+    }
+    c.in.erase(0, pos);
+
+    while (c.outPos < c.out.size())
+    {
+        ssize_t w = send(c.fd, c.out.data() + c.outPos, c.out.size() - c.outPos, MSG_NOSIGNAL);
+        if (w < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        c.outPos += static_cast<std::size_t>(w);
+    }
+    if (c.outPos == c.out.size())
+    {
+        c.out.clear();
+        c.outPos = 0;
+    }
+    else if (c.outPos > SERVER_OUT_HIGH)
+    {
+        c.out.erase(0, c.outPos);
+        c.outPos = 0;
+    }
+
+    bool backlog = c.out.size() - c.outPos >= SERVER_OUT_HIGH;
+    bool lineWaiting = std::memchr(c.in.data(), '\n', c.in.size()) != nullptr;
+    if (c.peerClosed && c.outPos == c.out.size() && !lineWaiting) return false;
+    unsigned want = (backlog || c.peerClosed ? 0u : unsigned(EPOLLIN)) | (c.outPos < c.out.size() ? unsigned(EPOLLOUT) : 0u);
+    if (want == 0) want = EPOLLOUT; //peer gone but lines left: keep going
+    if (want != c.interest)
+    {
+        epoll_event ev{};
+        ev.events = want;
+        ev.data.fd = c.fd;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c.fd, &ev);
+        c.interest = want;
+    }
+    return true;
+}
+
+// One event loop: accepts from the shared listeners and serves the
+// connections it accepted until the server is stopped.
+void serveLoop(ServerShared &server)
+{
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    for (int l : server.listeners)
+    {
+        if (l < 0) continue;
+        epoll_event ev{};
+        ev.events = EPOLLIN | (server.loops > 1 ? unsigned(EPOLLEXCLUSIVE) : 0u); //wake one loop per connection
+        ev.data.fd = l;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, l, &ev);
+    }
+    std::vector<std::unique_ptr<ServerConn>> conns; //indexed by fd
+    auto drop = [&](int fd)
+    {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        conns[fd].reset();
+    };
+    epoll_event events[256];
+    std::vector<char> chunk(1 << 16);
+    while (!serverStopping)
+    {
+        int ready = epoll_wait(epfd, events, 256, 200); //the timeout notices a signal taken by another thread
+        if (ready < 0 && errno != EINTR) break;
+        for (int e=0; e<ready; e++)
+        {
+            int fd = events[e].data.fd;
+            if (fd == server.listeners[0] || fd == server.listeners[1])
+            {
+                int client;
+                while ((client = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    if (fd == server.listeners[1])
+                    {
+                        int on = 1;
+                        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                    }
+                    if (std::size_t(client) >= conns.size()) conns.resize(client + 1);
+                    conns[client].reset(new ServerConn());
+                    conns[client]->fd = client;
+                    conns[client]->interest = EPOLLIN;
+                    epoll_event ev{};
+                    ev.events = EPOLLIN;
+                    ev.data.fd = client;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, client, &ev);
+                    ++server.served;
+                }
+                continue;
+            }
+            if (std::size_t(fd) >= conns.size() || !conns[fd]) continue;
+            ServerConn &c = *conns[fd];
+            if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                //one bounded read per wakeup keeps a busy client from starving the others
+                for (int reads=0; reads<16 && !c.peerClosed; reads++)
+                {
+                    ssize_t r = recv(fd, chunk.data(), chunk.size(), 0);
+                    if (r > 0) c.in.append(chunk.data(), r);
+                    else if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) c.peerClosed = true;
+                    else break;
+                    if (std::size_t(r) < chunk.size()) break;
+                }
+            }
+            if (!pumpConnection(epfd, c, server)) drop(fd);
+        }
+    }
+    for (std::size_t fd=0; fd<conns.size(); fd++) if (conns[fd]) drop(int(fd));
+    close(epfd);
+}
+
+int serveGradebook(Gradebook &gb, const char* socketPath, int tcpPort, int loops)
+{
+    ServerShared server(gb);
+    server.loops = loops;
+    if (socketPath && (server.listeners[0] = listenUnix(socketPath)) < 0)
+    {
+        cout<<"Cannot listen on "<<socketPath<<": "<<std::strerror(errno)<<"\n";
+        return 1;
+    }
+    if (tcpPort > 0 && (server.listeners[1] = listenLoopback(tcpPort)) < 0)
+    {
+        cout<<"Cannot listen on 127.0.0.1:"<<tcpPort<<": "<<std::strerror(errno)<<"\n";
+        return 1;
+    }
+    if (loops > 1) enableSharedReads(gb);
+    struct sigaction sa{};
+    sa.sa_handler = stopServer;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    cout<<"Serving "<<gb.studentCount<<" students on";
+    if (socketPath) cout<<" "<<socketPath;
+    if (tcpPort > 0) cout<<" 127.0.0.1:"<<tcpPort;
+    if (loops > 1) cout<<" with "<<loops<<" threads";
+    cout<<" (Ctrl-C to stop).\n"<<std::flush;
+
+    std::vector<std::thread> others;
+    for (int i=1; i<loops; i++) others.emplace_back([&server] { serveLoop(server); });
+    serveLoop(server);
+    for (std::thread &t : others) t.join();
+
+    for (int l : server.listeners) if (l >= 0) close(l);
+    if (socketPath) unlink(socketPath);
+    if (gb.journal) gb.journal->flush();
+    cout<<"Server stopped after "<<server.served<<" connection(s).\n";
+    return 0;
+}
+
+// ---------------- load generator (--load-test addr [CONNS [REQUESTS [DEPTH]]]) ----------------
+// Drives a running server from CONNS threads, each with its own connection
+// sending REQUESTS requests, DEPTH at a time. The mix is 80% GET, 15% SET, 4% TOP 10
+// and 1% SUMMARY over ids fetched from the server first. A request's latency
+// runs from sending its batch to receiving its answer.
+
+// addr is a socket path, or host:port for loopback TCP.
+int connectGradebook(const char* addr)
+{
+    const char* colon = std::strrchr(addr, ':');
+    if (colon && !std::strchr(addr, '/'))
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in in{};
+        in.sin_family = AF_INET;
+        in.sin_port = htons(static_cast<std::uint16_t>(std::atoi(colon + 1)));
+        std::string host(addr, colon);
+        if (inet_pton(AF_INET, host.empty() ? "127.0.0.1" : host.c_str(), &in.sin_addr) != 1
+            || connect(fd, reinterpret_cast<sockaddr*>(&in), sizeof(in)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        return fd;
+    }
+    sockaddr_un un{};
+    if (std::strlen(addr) >= sizeof(un.sun_path)) return -1;
+    un.sun_family = AF_UNIX;
+    std::strcpy(un.sun_path, addr);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&un), sizeof(un)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reads whole answers ("OK n" + n lines, or "ERR ...") off a blocking socket.
+struct AnswerReader
+{
+    int fd;
+    std::vector<char> buf = std::vector<char>(1 << 16);
+    std::size_t begin = 0, end = 0;
+
+    // Next line without its newline; false when the server hung up.
+    bool line(std::string &out)
+    {
+        while (true)
+        {
+            const char* nl = static_cast<const char*>(std::memchr(buf.data() + begin, '\n', end - begin));
+            if (nl)
+            {
+                out.assign(buf.data() + begin, nl - (buf.data() + begin));
+                begin = nl - buf.data() + 1;
+                return true;
+            }
+            if (begin > 0)
+            {
+                std::memmove(buf.data(), buf.data() + begin, end - begin);
+                end -= begin;
+                begin = 0;
+            }
+            if (end == buf.size()) buf.resize(buf.size() * 2);
+            ssize_t r = recv(fd, buf.data() + end, buf.size() - end, 0);
+            if (r <= 0) return false;
+            end += static_cast<std::size_t>(r);
+        }
+    }
+
+    // One answer; lines receives its payload. Returns 1 for OK, 0 for ERR, -1 on hang-up.
+    int answer(std::vector<std::string>* lines)
+    {
+        std::string status;
+        if (!line(status)) return -1;
+        if (status.compare(0, 3, "OK ") != 0) return 0;
+        int n = std::atoi(status.c_str() + 3);
+        std::string payload;
+        for (int i=0; i<n; i++)
+        {
+            if (!line(payload)) return -1;
+            if (lines) lines->push_back(payload);
+        }
+        return 1;
+    }
+};
+
+int loadTest(const char* addr, int conns, int requests, int depth)
+{
+    using Clock = std::chrono::steady_clock;
+    if (conns < 1 || conns > 1024 || requests < 1 || depth < 1 || depth > 4096)
+    {
+        cout<<"Connections must be between [1, 1024], requests at least 1 and depth between [1, 4096]\n";
+        return 1;
+    }
+    int fd = connectGradebook(addr);
+    if (fd < 0)
+    {
+        cout<<"Cannot connect to "<<addr<<"\n";
+        return 1;
+    }
+    std::vector<std::string> lines;
+    const char hello[] = "SUMMARY\nLIST 0 10000\n";
+    AnswerReader reader{fd};
+    if (!writeAll(fd, hello, sizeof(hello) - 1) || reader.answer(&lines) != 1 || reader.answer(&lines) != 1 || lines.size() < 2)
+    {
+        close(fd);
+        cout<<"The server at "<<addr<<" has no students to query\n";
+        return 1;
+    }
+    close(fd);
+    const char* testsField = std::strstr(lines[0].c_str(), "tests=");
+    int tests = testsField ? std::atoi(testsField + 6) : 1;
+    std::vector<std::string> ids;
+    for (std::size_t i=1; i<lines.size(); i++) ids.push_back(lines[i].substr(0, lines[i].find('\t')));
+
+    std::vector<std::vector<std::uint32_t>> latency(conns); //microseconds
+    std::vector<long long> errors(conns);
+    std::vector<std::thread> clients;
+    std::atomic<int> failed{0};
+    auto t0 = Clock::now();
+    for (int c=0; c<conns; c++)
+    {
+        clients.emplace_back([&, c]
+        {
+            int sock = connectGradebook(addr);
+            if (sock < 0) { ++failed; return; }
+            AnswerReader in{sock};
+            std::mt19937 rng(1000 + c);
+            std::string batch;
+            latency[c].reserve(requests);
+            for (int sent=0; sent<requests; )
+            {
+                int count = std::min(depth, requests - sent);
+                batch.clear();
+                for (int i=0; i<count; i++)
+                {
+                    int kind = int(rng() % 100);
+                    const std::string &id = ids[rng() % ids.size()];
+                    if (kind < 80) batch += "GET " + id + "\n";
+                    else if (kind < 95) batch += "SET " + id + " " + std::to_string(rng() % tests + 1) + " " + std::to_string(rng() % 101) + "\n";
+                    else if (kind < 99) batch += "TOP 10\n";
+                    else batch += "SUMMARY\n";
+                }
+                auto start = Clock::now();
+                if (!writeAll(sock, batch.data(), batch.size())) { ++failed; break; }
+                for (int i=0; i<count; i++)
+                {
+                    int ok = in.answer(nullptr);
+                    if (ok < 0) { ++failed; close(sock); return; }
+                    if (ok == 0) ++errors[c];
+                    latency[c].push_back(std::uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()));
+                }
+                sent += count;
+            }
+            close(sock);
+        });
+    }
+    for (std::thread &t : clients) t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    std::vector<std::uint32_t> all;
+    long long errorCount = 0;
+    for (int c=0; c<conns; c++)
+    {
+        all.insert(all.end(), latency[c].begin(), latency[c].end());
+        errorCount += errors[c];
+    }
+    std::sort(all.begin(), all.end());
+    auto pct = [&all](int p) { return all.empty() ? 0u : all[std::min(all.size() - 1, (all.size() * p + 99) / 100 - 1)]; };
+    cout<<"Connections      : "<<conns<<" x depth "<<depth<<"\n";
+    cout<<"Requests         : "<<all.size()<<" (GET 80%, SET 15%, TOP 10 4%, SUMMARY 1%)\n";
+    cout<<std::fixed<<std::setprecision(2);
+    cout<<"Elapsed          : "<<seconds<<" s\n";
+    cout<<"Throughput       : "<<(seconds > 0 ? all.size() / seconds : 0.0)<<" requests/s\n";
+    cout<<"Latency p50/p99  : "<<pct(50)<<" / "<<pct(99)<<" us\n";
+    cout<<"ERR answers      : "<<errorCount<<"\n";
+    if (failed > 0) cout<<"Failed clients   : "<<failed<<"\n";
+    return failed > 0 ? 1 : 0;
+}
+
+//done!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+int main(int argc, char** argv){
+    const char* importPath = nullptr;
+    const char* snapshotPath = nullptr;
+    std::string journalPath;
+    bool verifySnapshot = true;
+    bool compactOnly = false;
+    int threads = 0; //--threads N; 0 means one per hardware thread
+    int suiteStudents = 0, suiteTests = 4; //--bench-suite N [TESTS [SEED]]
+    const char* statsPath = nullptr;       //--stats-file: operation statistics are written here at exit
+    const char* servePath = nullptr;       //--serve: answer requests on this socket instead of the menu
+    const char* coursesDir = nullptr;      //--courses: one course per CSV file, see "multi-course store"
+    int servePort = 0;                     //--serve-tcp: also on 127.0.0.1:port
+    int serveThreads = 1;                  //--serve-threads: event loops answering requests
+    std::uint64_t suiteSeed = 12345;
+    Journal journal;
+    auto numberFollows = [&](int i) { return i + 1 < argc && isdigit(static_cast<unsigned char>(argv[i + 1][0])); };
+    for (int i=1; i<argc; i++)
+    {
+        if (std::strcmp(argv[i], "--bench-lookup") == 0)
+        {
+            return benchLookup(i + 1 < argc ? std::atoi(argv[i + 1]) : 100000);
+        }
+        else if (std::strcmp(argv[i], "--bench-columns") == 0)
+        {
+            return benchColumns(i + 1 < argc ? std::atoi(argv[i + 1]) : 10000000);
+        }
+        else if (std::strcmp(argv[i], "--bench-suite") == 0 && (!numberFollows(i) || std::atoi(argv[i + 1]) > 0))
+        {
+            //run after the loop so --threads can come later on the command line; N = 0 is a usage error
+            suiteStudents = numberFollows(i) ? std::atoi(argv[++i]) : 100000;
+            if (numberFollows(i)) suiteTests = std::atoi(argv[++i]);
+            if (numberFollows(i)) suiteSeed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--stress-readers") == 0)
+        {
+            int readers = numberFollows(i) ? std::atoi(argv[++i]) : int(std::max(1u, std::thread::hardware_concurrency()));
+            int seconds = numberFollows(i) ? std::atoi(argv[++i]) : 2;
+            int students = numberFollows(i) ? std::atoi(argv[++i]) : 100000;
+            return stressReaders(readers, seconds, students);
+        }
+        else if (std::strcmp(argv[i], "--load-test") == 0 && i + 1 < argc)
+        {
+            const char* addr = argv[++i];
+            int conns = numberFollows(i) ? std::atoi(argv[++i]) : 4;
+            int requests = numberFollows(i) ? std::atoi(argv[++i]) : 100000;
+            int depth = numberFollows(i) ? std::atoi(argv[++i]) : 32;
+            return loadTest(addr, conns, requests, depth);
+        }
+        else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            servePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--serve-tcp") == 0 && i + 1 < argc
+            && std::atoi(argv[i + 1]) >= 1 && std::atoi(argv[i + 1]) <= 65535)
+        {
+            servePort = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--serve-threads") == 0 && i + 1 < argc
+            && std::atoi(argv[i + 1]) >= 1 && std::atoi(argv[i + 1]) <= 256)
+        {
+            serveThreads = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--courses") == 0 && i + 1 < argc)
+        {
+            coursesDir = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--import") == 0 && i + 1 < argc)
+        {
+            importPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc)
+        {
+            snapshotPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--no-verify") == 0)
+        {
+            verifySnapshot = false;
+        }
+        else if (std::strcmp(argv[i], "--journal") == 0 && i + 1 < argc)
+        {
+            journalPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--fsync") == 0 && i + 1 < argc
+            && (std::strcmp(argv[i + 1], "always") == 0 || std::strcmp(argv[i + 1], "batch") == 0
+                || std::strcmp(argv[i + 1], "never") == 0))
+        {
+            ++i;
+            journal.policy = argv[i][0] == 'a' ? FsyncPolicy::Always
+                : argv[i][0] == 'b' ? FsyncPolicy::Batch : FsyncPolicy::Never;
+        }
+        else if (std::strcmp(argv[i], "--fsync-interval") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+        {
+            journal.intervalMs = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--stats-file") == 0 && i + 1 < argc)
+        {
+            statsPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--no-stats") == 0)
+        {
+            statsEnabled = false;
+        }
+        else if (std::strcmp(argv[i], "--compact") == 0)
+        {
+            compactOnly = true;
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc
+            && std::atoi(argv[i + 1]) >= 1 && std::atoi(argv[i + 1]) <= 256)
+        {
+            threads = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--grading") == 0 && i + 1 < argc && findGradingScheme(argv[i + 1]))
+        {
+            gradingScheme = findGradingScheme(argv[++i]);
+        }
+        else
+        {
+            cout<<"Usage: "<<argv[0]<<" [--snapshot file [--no-verify]] [--journal file]\n"
+                <<"       [--fsync always|batch|never] [--fsync-interval ms] [--compact]\n"
+                <<"       [--import file.csv] [--threads N] [--bench-lookup N] [--bench-columns N]\n"
+                <<"       [--stats-file file] [--no-stats] [--bench-suite N [TESTS [SEED]]]\n"
+                <<"       [--serve socket] [--serve-tcp port] [--serve-threads N]\n"
+                <<"       [--load-test socket|host:port [CONNS [REQUESTS [DEPTH]]]]\n"
+                <<"       [--stress-readers [READERS [SECONDS [STUDENTS]]]] [--grading plus-minus|letters]\n"
+                <<"       [--courses dir]\n";
+            return 1;
+        }
+    }
+    StatsFileAtExit statsAtExit{statsPath};
+    int poolThreads = threads > 0 ? threads : int(std::max(1u, std::thread::hardware_concurrency()));
+    if (suiteStudents > 0) return benchSuite(suiteStudents, suiteTests, suiteSeed, poolThreads);
+    //the journal sits next to the snapshot unless it is given explicitly
+    if (journalPath.empty() && snapshotPath) journalPath = std::string(snapshotPath) + ".wal";
+    if (compactOnly && !snapshotPath)
+    {
+        cout<<"--compact needs --snapshot FILE\n";
+        return 1;
+    }
+    if (coursesDir && (snapshotPath || !journalPath.empty() || importPath || servePath || servePort))
+    {
+        cout<<"--courses cannot be combined with --snapshot, --journal, --import or --serve;"
+            <<" each course keeps its own snapshot and journal in the course directory\n";
+        return 1;
+    }
+
+    //a script on stdin: no prompts, and cin/cout no longer kept in step with stdio
+    BatchInput batch;
+    if (!servePath && !servePort && !compactOnly && !isatty(STDIN_FILENO))
+    {
+        std::ios::sync_with_stdio(false);
+        cin.tie(nullptr);
+        batchInput = &batch;
+    }
+
+    cout<<"Student Gradebook Management System (C++)\n";
+    cout<<"-----------------------------------------\n";
+    Gradebook gb;
+    ThreadPool pool(poolThreads);
+    gb.pool = &pool;
+    if (coursesDir)
+    {
+        CourseCatalog catalog;
+        catalog.pool = &pool;
+        if (loadCourses(catalog, coursesDir, verifySnapshot) <= 0) return 1;
+        runCourseMenu(catalog, journal);
+        return 0;
+    }
+    if (snapshotPath && access(snapshotPath, F_OK) == 0)
+    {
+        std::string error;
+        if (!openSnapshot(gb, snapshotPath, verifySnapshot, error))
+        {
+            cout<<"Snapshot "<<snapshotPath<<" rejected: "<<error<<"\n";
+            return 1;
+        }
+        cout<<"Opened "<<snapshotPath<<" ("<<gb.studentCount<<" students, "<<gb.testCount<<" assessments).\n";
+    }
+    std::uint64_t journalBytes = 0;
+    if (!journalPath.empty())
+    {
+        long long applied = 0;
+        std::string error;
+        if (!replayJournal(gb, journalPath.c_str(), journalBytes, applied, error))
+        {
+            cout<<"Journal "<<journalPath<<" rejected: "<<error<<"\n";
+            return 1;
+        }
+        if (applied > 0) cout<<"Replayed "<<applied<<" change(s) from "<<journalPath<<".\n";
+    }
+    int firstImported = gb.studentCount;
+    if (importPath && importCsv(gb, importPath) < 0) return 1;
+    if (gb.testCount == 0)
+    {
+        gb.testCount = readIntRange("Enter the number of assessments per student (1-100): ", 1, MAX_TESTS);
+        if (batchInput && batchInput->failed) return 1;
+    }
+    if (!journalPath.empty())
+    {
+        std::string error;
+        if (!openJournal(journal, journalPath.c_str(), gb.testCount, journalBytes, error))
+        {
+            cout<<"Journal "<<journalPath<<": "<<error<<"\n";
+            return 1;
+        }
+        //imported rows went in before the journal was open; log them as one group
+        const Gradebook &loaded = gb;
+        journal.beginGroup();
+        for (int i=firstImported; i<loaded.studentCount; i++)
+        {
+            journalAdd(journal, studentId(loaded, i), studentName(loaded, i), studentRow(loaded, i), loaded.testCount);
+        }
+        journal.endGroup();
+        gb.journal = &journal;
+    }
+    if (compactOnly)
+    {
+        if (!saveSnapshot(gb, snapshotPath) || !resetJournal(journal))
         {
-            case 1: addStudent(ids, names, marks, studentCount, testCount); break;
-            case 2: updateMarks(ids, names, marks, studentCount, testCount); break;
-            case 3: printStudentReport(ids, names, marks, studentCount, testCount); break;
-            case 4: classSummaryAndRanging(ids, names, marks, studentCount, testCount); break;
-            case 5: listStudents(ids, names, marks, studentCount, testCount); break;
+            cout<<"Compaction failed.\n";
+            return 1;
         }
+        cout<<"Compacted "<<gb.studentCount<<" students into "<<snapshotPath<<".\n";
+        return 0;
+    }
+    if (servePath || servePort)
+    {
+        return serveGradebook(gb, servePath, servePort, serveThreads);
     }
+
+    runMenu(gb, journal, snapshotPath, false);
     return 0;
 }